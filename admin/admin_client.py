@@ -3,6 +3,9 @@ from datetime import datetime
 import threading
 import time
 import socket
+import itertools
+from collections import deque
+import tlm_schema
 
 class TelemetryInterface(ctk.CTk):
     def __init__(self):
@@ -14,6 +17,15 @@ class TelemetryInterface(ctk.CTk):
         self.is_connected = False
         self.receive_thread = None
         self.should_receive = False
+
+        # Idempotency: mutating commands carry "@<key>" so a resend after a lost
+        # reply is answered from the server's cache instead of applied twice.
+        # Keyed commands sent but not yet answered, oldest first; they are resent
+        # with the same keys once a reconnect has resumed the session.
+        self.session_token = None
+        self.key_counter = itertools.count(1)
+        self.key_prefix = f"{int(time.time()):x}"
+        self.unacked = deque()
         
         # Configure window
         self.title("Vehicle Telemetry System")
@@ -38,15 +50,20 @@ class TelemetryInterface(ctk.CTk):
         # Handle window close
         self.protocol("WM_DELETE_WINDOW", self.on_closing)
 
-    def send_command(self, message):
+    def send_command(self, message, idempotent=False):
         """Send command to server with error handling"""
         if not self.is_connected or self.server_socket is None:
             self.log_command("ERROR: Not connected to server")
             return False
             
+        if idempotent:
+            message = f"@{self.key_prefix}-{next(self.key_counter)} {message}"
         print(f"Sending: {message}")
         if not message.endswith('\n'):
             message += '\n'
+        if idempotent:
+            # kept until answered: a send error or a lost reply resends it after reconnect
+            self.unacked.append(message)
         try:
             self.server_socket.send(message.encode())
             return True
@@ -74,6 +91,11 @@ class TelemetryInterface(ctk.CTk):
             
             # Authenticate
             self.server_socket.send("AUTH admin admin123\n".encode())
+            # Open (or resume after a reconnect) the server-side dedup cache
+            if self.session_token:
+                self.server_socket.send(f"SESSION {self.session_token}\n".encode())
+            else:
+                self.server_socket.send("SESSION\n".encode())
             time.sleep(0.1)
             
             # Update connection state
@@ -162,17 +184,36 @@ class TelemetryInterface(ctk.CTk):
                     line, buffer = buffer.split('\n', 1)
                     line = line.strip()
                     
-                    if line and 'TLM' in line:
-                        # Parse telemetry: TLM speed=10;battery=85;ts=12:30:45;temp=45;dir=N
-                        telemetry_str = line.replace("TLM ", "")
-                        telemetry = dict([x.split("=") for x in telemetry_str.split(";")])
+                    if self.unacked and self.is_control_reply(line):
+                        self.unacked.popleft()
+
+                    if line.startswith("OK session="):
+                        token = line.split("=", 1)[1].split()[0]
+                        if line.endswith(" resumed") and token == self.session_token:
+                            self.resend_unacked()
+                        elif self.unacked:
+                            # the server no longer has these keys, so a resend could apply them twice
+                            self.after(0, lambda n=len(self.unacked): self.log_command(
+                                f"Session lost: outcome of {n} command(s) unknown"))
+                            self.unacked.clear()
+                        self.session_token = token
+                    elif line == "ERR unknown session":
+                        # Cache expired on the server; start a fresh one
+                        self.session_token = None
+                        self.server_socket.send("SESSION\n".encode())
+                    elif line and 'TLM' in line:
+                        # Parse telemetry with the decoder generated from the server schema
+                        telemetry = tlm_schema.parse_text(line)
+                        if telemetry is None:
+                            self.after(0, lambda msg=line: self.log_command(f"Malformed TLM: {msg}"))
+                            continue
                         
                         # Update telemetry data
-                        self.telemetry_data["speed"] = telemetry.get("speed", "0.0")
-                        self.telemetry_data["battery"] = telemetry.get("battery", "0.0")
-                        self.telemetry_data["time"] = telemetry.get("ts", datetime.now().strftime("%H:%M:%S"))
-                        self.telemetry_data["temperature"] = telemetry.get("temp", "0.0")
-                        self.telemetry_data["direction"] = telemetry.get("dir", "N")
+                        self.telemetry_data["speed"] = str(telemetry["speed"])
+                        self.telemetry_data["battery"] = str(telemetry["battery"])
+                        self.telemetry_data["time"] = telemetry["ts"]
+                        self.telemetry_data["temperature"] = str(telemetry["temp"])
+                        self.telemetry_data["direction"] = telemetry["dir"]
 
                         self.log_command("Telemetry received")
                         
@@ -198,6 +239,23 @@ class TelemetryInterface(ctk.CTk):
                     self.after(0, self.disconnect)
                 break
 
+    @staticmethod
+    def is_control_reply(line):
+        """Whether a server line answers a SPEED/TURN command rather than AUTH/SESSION"""
+        if not (line.startswith("OK ") or line.startswith("ERR ")):
+            return False
+        return not (line == "OK admin" or line.startswith("OK session=") or
+                    line in ("ERR unknown session", "ERR invalid credentials", "ERR backoff"))
+
+    def resend_unacked(self):
+        """Resend unanswered keyed commands with their original keys (receive thread)"""
+        for message in list(self.unacked):
+            self.after(0, lambda m=message.strip(): self.log_command(f"Resending: {m}"))
+            try:
+                self.server_socket.send(message.encode())
+            except Exception:
+                break   # still queued; the next reconnect tries again
+
     def on_closing(self):
         """Handle window close event"""
         if self.is_connected:
@@ -533,15 +591,15 @@ class TelemetryInterface(ctk.CTk):
     
     # Command functions
     def speed_up(self):
-        if self.send_command("SPEED UP"):
+        if self.send_command("SPEED UP", idempotent=True):
             self.log_command("Command sent: SPEED UP")
     
     def slow_down(self):
-        if self.send_command("SLOW DOWN"):
+        if self.send_command("SLOW DOWN", idempotent=True):
             self.log_command("Command sent: SLOW DOWN")
     
     def change_direction(self, direction):
-        if self.send_command("TURN " + direction):
+        if self.send_command("TURN " + direction, idempotent=True):
             self.log_command(f"Command sent: TURN {direction}")
 
 if __name__ == "__main__":
@@ -0,0 +1,107 @@
+# GENERATED by server/gen_schema.py from server/tlm_schema.def - do not edit.
+"""TLM decoders specialized for the server's telemetry schema."""
+import struct
+import time
+
+MAGIC = 0xA7
+FIELDS = ("speed", "battery", "temp", "dir", "ts")
+FULL_MASK = 0x1F
+
+
+def _int_end(s, p):
+    """End of the integer at s[p:], or p if there is none (a lone "-" is not one)."""
+    n = len(s)
+    q = p + 1 if p < n and s[p] == '-' else p
+    e = q
+    while e < n and '0' <= s[e] <= '9':
+        e += 1
+    return e if e > q else p
+
+
+def parse_text(line):
+    """Decode a text TLM line into a dict, or return None if it does not match."""
+    line = line.rstrip()
+    p = 0
+    if not line.startswith("TLM speed=", p):
+        return None
+    p += 10
+    e = _int_end(line, p)
+    if e == p:
+        return None
+    v_speed = int(line[p:e])
+    p = e
+    if not line.startswith(";battery=", p):
+        return None
+    p += 9
+    e = _int_end(line, p)
+    if e == p:
+        return None
+    v_battery = int(line[p:e])
+    p = e
+    if not line.startswith(";temp=", p):
+        return None
+    p += 6
+    e = _int_end(line, p)
+    if e == p:
+        return None
+    v_temp = int(line[p:e])
+    p = e
+    if not line.startswith(";dir=", p):
+        return None
+    p += 5
+    v_dir = line[p:p + 1]
+    p += 1
+    if not line.startswith(";ts=", p):
+        return None
+    p += 4
+    e = len(line)
+    v_ts = line[p:e]
+    p = e
+    if p != len(line):
+        return None
+    return {"speed": v_speed, "battery": v_battery, "temp": v_temp, "dir": v_dir, "ts": v_ts}
+
+
+def decode_binary(buf, frame):
+    """Apply one binary frame (full or delta) at the start of buf to the dict frame.
+
+    Returns bytes consumed, 0 if incomplete, or None if malformed; frame is
+    only updated from a frame whose length matches the fields it carries.
+    """
+    if len(buf) < 3:
+        return 0
+    if buf[0] != MAGIC:
+        return None
+    size = 3 + buf[2]
+    if len(buf) < size:
+        return 0
+    p = 3
+    if buf[1] == ord('F'):
+        mask = FULL_MASK
+    elif buf[1] == ord('D') and size > 3:
+        mask = buf[3] & FULL_MASK
+        p = 4
+    else:
+        return None
+    need = (4 if mask & 1 else 0) + (4 if mask & 2 else 0) + (4 if mask & 4 else 0) + (1 if mask & 8 else 0) + (8 if mask & 16 else 0)
+    if p + need != size:
+        return None
+    if mask & 1:
+        frame["speed"] = struct.unpack_from("<i", buf, p)[0]
+        p += 4
+    if mask & 2:
+        frame["battery"] = struct.unpack_from("<i", buf, p)[0]
+        p += 4
+    if mask & 4:
+        frame["temp"] = struct.unpack_from("<i", buf, p)[0]
+        p += 4
+    if mask & 8:
+        frame["dir"] = chr(buf[p])
+        p += 1
+    if mask & 16:
+        try:
+            frame["ts"] = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(struct.unpack_from("<q", buf, p)[0]))
+        except (OverflowError, OSError, ValueError):
+            return None
+        p += 8
+    return size
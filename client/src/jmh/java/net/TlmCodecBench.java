@@ -0,0 +1,84 @@
+package net;
+
+import org.openjdk.jmh.annotations.*;
+import org.openjdk.jmh.infra.Blackhole;
+
+import java.nio.charset.StandardCharsets;
+import java.util.Map;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * JMH benchmarks for the telemetry decoders, one message per invocation.
+ *
+ * <p>Compares the map-based {@link MessageParser#parseTlm(String)} with the
+ * {@link TlmCodec} decoders generated from the schema: text from a String,
+ * text from raw socket bytes (what {@link NetworkClient} does) and binary.
+ * Run with the GC profiler to see the allocation per message:
+ * <pre>
+ * mvn -Pjmh package
+ * java -jar target/benchmarks.jar TlmCodecBench -prof gc
+ * </pre>
+ *
+ * @author Autonomous Vehicle Team
+ * @version 1.0
+ * @since 2025
+ */
+@BenchmarkMode(Mode.AverageTime)
+@OutputTimeUnit(TimeUnit.NANOSECONDS)
+@Warmup(iterations = 5, time = 1)
+@Measurement(iterations = 5, time = 1)
+@Fork(1)
+@State(Scope.Thread)
+public class TlmCodecBench {
+    /** A text frame as the server sends it (TLM line, without the newline). */
+    private final String line = "TLM speed=42;battery=87;temp=51;dir=E;ts=2025-03-14 15:09:26";
+
+    /** The same line as raw socket bytes. */
+    private final byte[] lineBytes = line.getBytes(StandardCharsets.US_ASCII);
+
+    /** The same sample as a binary full frame (FORMAT BIN). */
+    private final byte[] bin = fullFrame(42, 87, 51, 'E', 1741964966L);
+
+    private final TlmCodec.Frame frame = new TlmCodec.Frame();
+
+    @Benchmark
+    public Map<String,String> mapParser(){
+        return MessageParser.parseTlm(line);
+    }
+
+    @Benchmark
+    public void textString(Blackhole bh){
+        bh.consume(TlmCodec.decodeText(line, frame));
+        consume(bh);
+    }
+
+    @Benchmark
+    public void textBytes(Blackhole bh){
+        bh.consume(TlmCodec.decodeText(lineBytes, 0, lineBytes.length, frame));
+        consume(bh);
+    }
+
+    @Benchmark
+    public void binary(Blackhole bh){
+        bh.consume(TlmCodec.decodeBinary(bin, 0, bin.length, frame));
+        consume(bh);
+    }
+
+    private void consume(Blackhole bh){
+        bh.consume(frame.speed); bh.consume(frame.battery); bh.consume(frame.temp);
+        bh.consume(frame.dir); bh.consume(frame.tsLen); bh.consume(frame.tsEpoch());
+    }
+
+    /** Encodes a full binary frame: 0xA7 'F' len speed battery temp dir ts (little endian). */
+    private static byte[] fullFrame(int speed, int battery, int temp, char dir, long ts){
+        byte[] b = new byte[3 + 21];
+        b[0] = (byte) TlmCodec.MAGIC; b[1] = 'F'; b[2] = 21;
+        int p = 3;
+        for (long v : new long[]{ speed, battery, temp }){
+            for (int i = 0; i < 4; i++) b[p++] = (byte) (v >> (8 * i));
+        }
+        b[p++] = (byte) dir;
+        for (int i = 0; i < 8; i++) b[p++] = (byte) (ts >> (8 * i));
+        return b;
+    }
+}
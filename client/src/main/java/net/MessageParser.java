@@ -15,6 +15,9 @@ import java.util.Map;
  * <p>Each key-value pair is separated by semicolons, and each pair uses
  * the format "key=value".
  * 
+ * <p>This is the general, map-based parser. The observer's telemetry path uses
+ * the allocation-free decoders generated from the schema in {@link TlmCodec}.
+ * 
  * @author Autonomous Vehicle Team
  * @version 1.0
  * @since 2025
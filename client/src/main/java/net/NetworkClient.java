@@ -2,14 +2,16 @@ package net;
 
 import model.TelemetryModel;
 
+import javafx.animation.AnimationTimer;
 import javafx.application.Platform;
 
 import java.io.*;
 import java.net.Socket;
 import java.net.SocketException;
-import java.time.Instant;
-import java.util.Map;
+import java.nio.charset.StandardCharsets;
 import java.util.concurrent.*;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.atomic.AtomicReference;
 import java.util.function.Consumer;
 
 /**
@@ -20,7 +22,9 @@ import java.util.function.Consumer;
  * <p>Key features:
  * <ul>
  *   <li>Automatic connection with exponential backoff retry</li>
- *   <li>Asynchronous message processing on JavaFX Application Thread</li>
+ *   <li>Telemetry decoded on the reader thread straight from the socket bytes,
+ *       without allocating, and applied to the model at most once per rendered
+ *       frame; intermediate samples are coalesced and counted</li>
  *   <li>Clean shutdown and resource management</li>
  *   <li>Status callbacks for UI updates</li>
  *   <li>Comprehensive logging</li>
@@ -62,8 +66,11 @@ public class NetworkClient {
     /** TCP socket connection to the server. */
     private Socket socket;
     
-    /** Input stream reader for receiving messages. */
-    private BufferedReader in;
+    /** Raw input stream; lines are split and decoded by {@link #listenLoop()}. */
+    private InputStream in;
+
+    /** Receive buffer (reader thread only); a longer line is skipped. */
+    private final byte[] rbuf = new byte[64 * 1024];
     
     /** Output stream writer for sending messages. */
     private PrintWriter out;
@@ -74,6 +81,36 @@ public class NetworkClient {
     /** Executor service for reading messages asynchronously. */
     private final ExecutorService readerExec = Executors.newSingleThreadExecutor();
 
+    /**
+     * Newest decoded sample not yet applied to the model, or null. Written by the
+     * reader thread, taken by {@link #uiTimer}; an unseen sample that gets replaced
+     * is counted in {@link #dropped}.
+     */
+    private final AtomicReference<TlmCodec.Frame> latest = new AtomicReference<>();
+
+    /** Decode target for the next TLM line (reader thread only). */
+    private TlmCodec.Frame spare = new TlmCodec.Frame();
+
+    /** Frame the UI has applied and handed back for reuse, or null. */
+    private final AtomicReference<TlmCodec.Frame> free = new AtomicReference<>();
+
+    /** Samples replaced before a frame was rendered. */
+    private final AtomicLong dropped = new AtomicLong();
+
+    /**
+     * Applies {@link #latest} to the model once per JavaFX pulse, so the
+     * Application Thread sees one update per frame however fast telemetry arrives.
+     */
+    private final AnimationTimer uiTimer = new AnimationTimer() {
+        @Override
+        public void handle(long now) {
+            TlmCodec.Frame f = latest.getAndSet(null);
+            if (f == null) return;
+            model.update(f.speed, f.battery, f.temp, String.valueOf(f.dir), f.tsString());
+            free.set(f);
+        }
+    };
+
     /**
      * Constructs a new NetworkClient with the specified connection parameters.
      * 
@@ -101,7 +138,7 @@ public class NetworkClient {
      */
     public void start(){
         running = true;
-        Platform.runLater(() -> statusCb.accept("Connecting..."));
+        Platform.runLater(() -> { statusCb.accept("Connecting..."); uiTimer.start(); });
         scheduler.execute(this::connectWithBackoff);
     }
 
@@ -112,6 +149,7 @@ public class NetworkClient {
      */
     public void stop(){
         running = false;
+        Platform.runLater(uiTimer::stop);
         scheduler.shutdownNow();
         readerExec.shutdownNow();
         closeSocket();
@@ -133,7 +171,7 @@ public class NetworkClient {
                 listenLoop();
                 // if listenLoop returns, we were disconnected
                 if (!running) break;
-                log("Disconnected from server, will attempt reconnect");
+                log("Disconnected from server, will attempt reconnect (" + dropped.get() + " telemetry samples coalesced so far)");
                 Platform.runLater(() -> statusCb.accept("Disconnected, reconnecting..."));
             } catch (IOException e){
                 log("Connection failed: " + e.getMessage());
@@ -157,7 +195,7 @@ public class NetworkClient {
         closeSocket();
         socket = new Socket(host, port);
         socket.setTcpNoDelay(true);
-        in = new BufferedReader(new InputStreamReader(socket.getInputStream(), "UTF-8"));
+        in = socket.getInputStream();
         out = new PrintWriter(new OutputStreamWriter(socket.getOutputStream(), "UTF-8"), true);
         // send HELLO <name>
         out.printf("HELLO name=%s\n", clientName);
@@ -166,7 +204,8 @@ public class NetworkClient {
     /**
      * Main message listening loop that processes incoming data from the server.
      * Runs in a separate thread to avoid blocking the connection management thread.
-     * Messages are processed on the JavaFX Application Thread for UI updates.
+     * Lines are split in {@link #rbuf} and parsed in place on that thread; only the
+     * latest telemetry sample reaches the JavaFX Application Thread (see {@link #uiTimer}).
      * 
      * @throws IOException If I/O error occurs during message reading
      */
@@ -174,10 +213,20 @@ public class NetworkClient {
         // read loop executed in readerExec so connectWithBackoff can wait
         Future<?> f = readerExec.submit(() -> {
             try {
-                String line;
-                while (running && (line = in.readLine()) != null){
-                    final String l = line;
-                    Platform.runLater(() -> processLine(l));
+                int len = 0, scan = 0, n;
+                boolean skipping = false;   // inside a line longer than rbuf
+                while (running && (n = in.read(rbuf, len, rbuf.length - len)) > 0){
+                    len += n;
+                    int start = 0;
+                    for (; scan < len; scan++){
+                        if (rbuf[scan] != '\n') continue;
+                        if (!skipping) processLine(rbuf, start, scan);
+                        skipping = false;
+                        start = scan + 1;
+                    }
+                    if (start == 0 && len == rbuf.length){ skipping = true; len = 0; }
+                    else { System.arraycopy(rbuf, start, rbuf, 0, len - start); len -= start; }
+                    scan = len;
                 }
             } catch (SocketException se){
                 // socket closed or reset
@@ -199,38 +248,67 @@ public class NetworkClient {
 
     /**
      * Processes a single message line received from the server.
-     * Handles TLM (telemetry) messages by parsing and updating the model.
-     * Also processes OK, ERR, and BYE protocol messages.
+     * TLM (telemetry) lines are decoded and published to {@link #latest};
+     * OK, ERR and BYE replies are logged.
      * 
-     * <p>This method runs on the JavaFX Application Thread to ensure thread-safe
-     * UI updates when the model properties change.
+     * <p>This method runs on the reader thread and never touches the model: at
+     * high tick rates one UI task per line would flood the JavaFX Application Thread.
+     * Telemetry is decoded from the bytes in place into a recycled frame, so
+     * steady-state telemetry allocates nothing; only logged replies become Strings.
      * 
-     * @param line The message line to process (null-safe)
+     * @param b Buffer holding the line
+     * @param from Start offset
+     * @param to End offset (exclusive), at the newline
      */
-    private void processLine(String line){
-        if(line == null) return;
-        line = line.trim();
-        if(line.isEmpty()) return;
-        log("RECV: " + line);
-        if(line.startsWith("TLM")){
-            Map<String,String> m = MessageParser.parseTlm(line);
-            try {
-                int sp = Integer.parseInt(m.getOrDefault("speed","0"));
-                int bt = Integer.parseInt(m.getOrDefault("battery","0"));
-                int tp = Integer.parseInt(m.getOrDefault("temp","0"));
-                String dir = m.getOrDefault("dir","N");
-                String ts = m.getOrDefault("ts", String.valueOf(Instant.now().getEpochSecond()));
-                model.update(sp, bt, tp, dir, ts);
-            } catch (NumberFormatException nfe){
+    private void processLine(byte[] b, int from, int to){
+        while (from < to && b[from] <= ' ' && b[from] >= 0) from++;
+        if (from == to) return;
+        if (startsWith(b, from, to, "TLM")){
+            if (TlmCodec.decodeText(b, from, to, spare)) {
+                TlmCodec.Frame unseen = latest.getAndSet(spare);
+                if (unseen != null) {
+                    // never rendered, so nobody else holds it: decode the next line into it
+                    dropped.incrementAndGet();
+                    spare = unseen;
+                } else {
+                    TlmCodec.Frame back = free.getAndSet(null);
+                    spare = back != null ? back : new TlmCodec.Frame();
+                }
+            } else {
                 log("Malformed TLM values");
             }
-        } else if(line.startsWith("OK") || line.startsWith("ERR") || line.startsWith("BYE")){
-            // show in log; possible future handling
+        } else if(startsWith(b, from, to, "OK") || startsWith(b, from, to, "ERR") || startsWith(b, from, to, "BYE")){
+            log("RECV: " + new String(b, from, to - from, StandardCharsets.UTF_8).trim());
         } else {
             // other messages
         }
     }
 
+    /**
+     * Tells whether {@code b[from, to)} starts with an ASCII prefix.
+     * 
+     * @param b Buffer holding the line
+     * @param from Start offset
+     * @param to End offset (exclusive)
+     * @param prefix Prefix to look for
+     * @return true if the line starts with {@code prefix}
+     */
+    private static boolean startsWith(byte[] b, int from, int to, String prefix){
+        if (to - from < prefix.length()) return false;
+        for (int i = 0; i < prefix.length(); i++) if (b[from + i] != prefix.charAt(i)) return false;
+        return true;
+    }
+
+    /**
+     * Returns how many telemetry samples were replaced by a newer one before the
+     * UI rendered them (coalesced at frame rate).
+     * 
+     * @return Number of dropped intermediate samples since start
+     */
+    public long getDroppedFrames(){
+        return dropped.get();
+    }
+
     /**
      * Logs a message with timestamp using the provided log callback.
      * Formats the message with current local time for better readability.
@@ -0,0 +1,291 @@
+// GENERATED by server/gen_schema.py from server/tlm_schema.def - do not edit.
+package net;
+
+import java.time.Instant;
+import java.time.ZoneId;
+import java.time.format.DateTimeFormatter;
+
+/**
+ * Telemetry frame codec generated from the server's TLM schema.
+ *
+ * <p>Each decoder is specialized for the exact field order of the schema:
+ * it checks the expected labels in place and converts values without
+ * splitting the line or looking fields up by name. Decoders write into a
+ * caller-owned {@link Frame} and allocate nothing: timestamps are kept as the
+ * received characters or epoch seconds and only become a String on request.
+ *
+ * <p>Supported encodings:
+ * <ul>
+ *   <li>Text: <code>TLM speed=&lt;int&gt;;battery=&lt;int&gt;;temp=&lt;int&gt;;dir=&lt;dir&gt;;ts=&lt;time&gt;</code>,
+ *       from a {@link CharSequence} or straight from socket bytes</li>
+ *   <li>Binary full frame: <code>0xA7 'F' len fields...</code></li>
+ *   <li>Binary delta frame: <code>0xA7 'D' len mask changed-fields...</code></li>
+ * </ul>
+ *
+ * @author Autonomous Vehicle Team
+ * @version 1.0
+ * @since 2025
+ */
+public final class TlmCodec {
+    /** First byte of every binary frame. */
+    public static final int MAGIC = 0xA7;
+
+    /** Field names in wire order. */
+    public static final String[] FIELDS = { "speed", "battery", "temp", "dir", "ts" };
+
+    /** Delta mask with every field set (a full frame). */
+    public static final int FULL_MASK = 0x1F;
+
+    /** Longest text timestamp kept, in characters. */
+    public static final int TIME_TEXT_MAX = 32;
+
+    /** Timestamp format used by the text encoding (server local time). */
+    private static final DateTimeFormatter TS_FMT =
+            DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm:ss").withZone(ZoneId.systemDefault());
+
+    private TlmCodec(){}
+
+    /**
+     * Mutable decoded frame; decoders overwrite its fields in place so one
+     * instance can be reused for every message.
+     */
+    public static final class Frame {
+        /** Field <code>speed</code> (INT). */
+        public int speed = 0;
+        /** Field <code>battery</code> (INT). */
+        public int battery = 0;
+        /** Field <code>temp</code> (INT). */
+        public int temp = 0;
+        /** Field <code>dir</code> (DIR). */
+        public char dir = 'N';
+        /** Field <code>ts</code> (TIME) as text, valid for {@link #tsLen} chars. */
+        final char[] tsText = new char[TIME_TEXT_MAX];
+        /** Length of {@link #tsText}, 0 if the last value came from a binary frame. */
+        int tsLen = 0;
+        /** Field <code>ts</code> (TIME) from a binary frame: epoch seconds, or {@link Long#MIN_VALUE}. */
+        long tsEpoch = Long.MIN_VALUE;
+
+        /**
+         * Returns <code>ts</code> as text. This allocates, so call it when the
+         * value is displayed rather than for every message.
+         *
+         * @return "yyyy-MM-dd HH:mm:ss" as sent, or "-" if none was received yet
+         */
+        public String tsString(){
+            if (tsLen > 0) return new String(tsText, 0, tsLen);
+            if (tsEpoch != Long.MIN_VALUE) return TS_FMT.format(Instant.ofEpochSecond(tsEpoch));
+            return "-";
+        }
+
+        /**
+         * Returns <code>ts</code> as epoch seconds when it came from a binary frame.
+         *
+         * @return Epoch seconds, or {@link Long#MIN_VALUE} for text timestamps
+         */
+        public long tsEpoch(){ return tsEpoch; }
+    }
+
+    /**
+     * Decodes a text TLM line into {@code f}.
+     *
+     * @param line Line, with or without the trailing newline
+     * @param f Frame to fill
+     * @return true if the line matched the schema; {@code f} may be partially updated otherwise
+     */
+    public static boolean decodeText(CharSequence line, Frame f){
+        return line != null && decodeText(line, 0, line.length(), f);
+    }
+
+    /**
+     * Decodes the text TLM line in {@code s[from, to)} into {@code f} without
+     * allocating. Fields must come in schema order; trailing whitespace is ignored.
+     *
+     * @param s Characters holding the line
+     * @param from Start offset
+     * @param to End offset (exclusive)
+     * @param f Frame to fill
+     * @return true if the line matched the schema; {@code f} may be partially updated otherwise
+     */
+    public static boolean decodeText(CharSequence s, int from, int to, Frame f){
+        int p = from, e, n = to;
+        long v;
+        while (n > p && s.charAt(n-1) <= ' ') n--;
+        if (!at(s, p, n, "TLM speed=")) return false;
+        p += 10;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.speed = (int) v;
+        p = e;
+        if (!at(s, p, n, ";battery=")) return false;
+        p += 9;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.battery = (int) v;
+        p = e;
+        if (!at(s, p, n, ";temp=")) return false;
+        p += 6;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.temp = (int) v;
+        p = e;
+        if (!at(s, p, n, ";dir=")) return false;
+        p += 5;
+        if (p >= n) return false;
+        f.dir = s.charAt(p++);
+        if (!at(s, p, n, ";ts=")) return false;
+        p += 4;
+        e = n;
+        if (e - p > f.tsText.length) return false;
+        for (int i = p; i < e; i++) f.tsText[i - p] = s.charAt(i);
+        f.tsLen = e - p; f.tsEpoch = Long.MIN_VALUE;
+        p = e;
+        return p == n;
+    }
+
+    /**
+     * Decodes the text TLM line in {@code s[from, to)} into {@code f} without
+     * allocating. Fields must come in schema order; trailing whitespace is ignored.
+     *
+     * @param s Raw socket bytes holding the line (ASCII)
+     * @param from Start offset
+     * @param to End offset (exclusive)
+     * @param f Frame to fill
+     * @return true if the line matched the schema; {@code f} may be partially updated otherwise
+     */
+    public static boolean decodeText(byte[] s, int from, int to, Frame f){
+        int p = from, e, n = to;
+        long v;
+        while (n > p && (char) (s[n-1] & 0xFF) <= ' ') n--;
+        if (!at(s, p, n, "TLM speed=")) return false;
+        p += 10;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.speed = (int) v;
+        p = e;
+        if (!at(s, p, n, ";battery=")) return false;
+        p += 9;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.battery = (int) v;
+        p = e;
+        if (!at(s, p, n, ";temp=")) return false;
+        p += 6;
+        e = intEnd(s, p, n);
+        if (e == p) return false;
+        v = intValue(s, p, e);
+        if (v == Long.MIN_VALUE) return false;
+        f.temp = (int) v;
+        p = e;
+        if (!at(s, p, n, ";dir=")) return false;
+        p += 5;
+        if (p >= n) return false;
+        f.dir = (char) (s[p++] & 0xFF);
+        if (!at(s, p, n, ";ts=")) return false;
+        p += 4;
+        e = n;
+        if (e - p > f.tsText.length) return false;
+        for (int i = p; i < e; i++) f.tsText[i - p] = (char) (s[i] & 0xFF);
+        f.tsLen = e - p; f.tsEpoch = Long.MIN_VALUE;
+        p = e;
+        return p == n;
+    }
+
+    /**
+     * Decodes one binary frame (full or delta) starting at {@code off}.
+     * A delta frame only overwrites the fields it carries.
+     *
+     * @param b Buffer holding the frame
+     * @param off Offset of the magic byte
+     * @param len Number of valid bytes from {@code off}
+     * @param f Frame to update
+     * @return Bytes consumed, 0 if the frame is incomplete, or -1 if malformed
+     */
+    public static int decodeBinary(byte[] b, int off, int len, Frame f){
+        if (len < 3) return 0;
+        if ((b[off] & 0xFF) != MAGIC) return -1;
+        int size = 3 + (b[off+2] & 0xFF);
+        if (len < size) return 0;
+        int p = off + 3, mask;
+        if (b[off+1] == 'F') mask = FULL_MASK;
+        else if (b[off+1] == 'D' && size > 3) mask = b[p++] & FULL_MASK;
+        else return -1;
+        int need = ((mask & 1) != 0 ? 4 : 0)
+                 + ((mask & 2) != 0 ? 4 : 0)
+                 + ((mask & 4) != 0 ? 4 : 0)
+                 + ((mask & 8) != 0 ? 1 : 0)
+                 + ((mask & 16) != 0 ? 8 : 0);
+        if (p + need != off + size) return -1;
+        if ((mask & 1) != 0){ f.speed = (int) le(b, p, 4); p += 4; }
+        if ((mask & 2) != 0){ f.battery = (int) le(b, p, 4); p += 4; }
+        if ((mask & 4) != 0){ f.temp = (int) le(b, p, 4); p += 4; }
+        if ((mask & 8) != 0){ f.dir = (char) (b[p] & 0xFF); p += 1; }
+        if ((mask & 16) != 0){ f.tsEpoch = le(b, p, 8); f.tsLen = 0; p += 8; }
+        return size;
+    }
+
+    private static boolean at(CharSequence s, int p, int n, String lab){
+        if (n - p < lab.length()) return false;
+        for (int i = 0; i < lab.length(); i++) if (s.charAt(p + i) != lab.charAt(i)) return false;
+        return true;
+    }
+
+    /** End of the integer at {@code p}: an optional '-' and at least one digit; {@code p} if none. */
+    private static int intEnd(CharSequence s, int p, int n){
+        int d = p < n && s.charAt(p) == '-' ? p + 1 : p, e = d;
+        while (e < n && s.charAt(e) >= '0' && s.charAt(e) <= '9') e++;
+        return e == d ? p : e;
+    }
+
+    /** Value of the integer in {@code s[p, e)}, or {@link Long#MIN_VALUE} if it does not fit an int. */
+    private static long intValue(CharSequence s, int p, int e){
+        boolean neg = s.charAt(p) == '-';
+        long v = 0;
+        for (int i = neg ? p + 1 : p; i < e; i++){
+            v = v * 10 + (s.charAt(i) - '0');
+            if (v > 0x80000000L) return Long.MIN_VALUE;
+        }
+        if (neg) v = -v;
+        return v >= Integer.MIN_VALUE && v <= Integer.MAX_VALUE ? v : Long.MIN_VALUE;
+    }
+
+    private static boolean at(byte[] s, int p, int n, String lab){
+        if (n - p < lab.length()) return false;
+        for (int i = 0; i < lab.length(); i++) if ((char) (s[p + i] & 0xFF) != lab.charAt(i)) return false;
+        return true;
+    }
+
+    /** End of the integer at {@code p}: an optional '-' and at least one digit; {@code p} if none. */
+    private static int intEnd(byte[] s, int p, int n){
+        int d = p < n && (char) (s[p] & 0xFF) == '-' ? p + 1 : p, e = d;
+        while (e < n && (char) (s[e] & 0xFF) >= '0' && (char) (s[e] & 0xFF) <= '9') e++;
+        return e == d ? p : e;
+    }
+
+    /** Value of the integer in {@code s[p, e)}, or {@link Long#MIN_VALUE} if it does not fit an int. */
+    private static long intValue(byte[] s, int p, int e){
+        boolean neg = (char) (s[p] & 0xFF) == '-';
+        long v = 0;
+        for (int i = neg ? p + 1 : p; i < e; i++){
+            v = v * 10 + ((char) (s[i] & 0xFF) - '0');
+            if (v > 0x80000000L) return Long.MIN_VALUE;
+        }
+        if (neg) v = -v;
+        return v >= Integer.MIN_VALUE && v <= Integer.MAX_VALUE ? v : Long.MIN_VALUE;
+    }
+
+    private static long le(byte[] b, int p, int n){
+        long v = 0;
+        for (int i = n - 1; i >= 0; i--) v = (v << 8) | (b[p+i] & 0xFF);
+        return n == 4 ? (int) v : v;
+    }
+}
@@ -0,0 +1,1248 @@
+// Autonomous Vehicle Project - libavt core (see avt.h)
+//
+// Application protocol (text, \n-terminated):
+//  Client -> Server:
+//    HELLO [room=<room>] [name=<text>]   room=: while still in the lobby, when the server hosts rooms;
+//                                        only an ADMIN may create a room, others join existing ones
+//    AUTH <user> <pass>          (admin: admin / admin123)
+//    ROLE?
+//    LIST USERS [off] [lim] [filter]  (ADMIN only) filter: ADMIN|OBSERVER|<name substring>
+//    STATS                       (ADMIN only)
+//    SPEED UP | SLOW DOWN        (ADMIN only)
+//    TURN LEFT | TURN RIGHT      (ADMIN only)
+//    BEGIN ... COMMIT | ABORT    (ADMIN only) queue SPEED/TURN steps silently, then
+//                                apply all of them atomically or none; one reply
+//    FORMAT TEXT|BIN|DELTA       telemetry encoding for this connection (see tlm.h)
+//    DERIVED ALL|OFF|<m>[,<m>...] subscribe to derived metrics: drain,range,temp_time,distance
+//    SESSION [<token>]           (ADMIN only) open (or resume) the idempotency-key cache
+//    HISTORY <from> [<to>] [points=<n>] [field=<f>]   (ADMIN only) stored telemetry in [from, to]: epoch
+//                                seconds, or <= 0 for seconds before now (to defaults to now);
+//                                points= downsamples to ~n samples by field (LTTB); needs cfg.hist_mem
+//    @<key> <SPEED|TURN|COMMIT>  (ADMIN only) idempotent form: a repeated key returns the cached
+//                                reply; ERR busy if no cache record is free (nothing applied).
+//                                Inside BEGIN only COMMIT takes a key: a keyed step is ERR bad key
+//                                and fails the batch
+//    QUIT
+//  Server -> Client:
+//    OK <msg> | ERR <reason> | BYE
+//    ERR backoff                 (peer exceeded failed-AUTH limit; AUTH not evaluated)
+//    ERR busy                    (connection refused by admission control, then closed)
+//    OK batch n=<k> speed=<int> dir=<N|E|S|W> | ERR batch step=<i> <reason>
+//    TLM speed=<int>;battery=<int>;temp=<int>;dir=<N|E|S|W>;ts=<YYYY-MM-DD HH:MM:SS>
+//    (or binary full/delta frames after FORMAT BIN|DELTA; fields: tlm_schema.def)
+//    DRV drain=<%/h>;range=<km|-1>;temp_time=<s>;distance=<m>   after TLM, subscribed fields only
+//    RATE period_ms=<n>          adaptive rate on: telemetry now arrives every n ms
+//    HRU n=<k>;speed=<min>/<avg>/<max>;...;dir=<last>;ts=<bucket start>   HISTORY rollups,
+//                                for minutes no longer held raw; then stored samples as
+//    HST speed=...;ts=...        (TLM text format), ending with OK history raw=<n> rollups=<m>
+//                                [scanned=<rows before downsampling>]
+
+#define _GNU_SOURCE
+#include "avt.h"
+#include "hist.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+
+#define MAX_LINE  2048
+
+// Failed-AUTH throttling (per peer IPv4)
+#define AUTH_SLOTS      1024  // 256 sets of AUTH_WAYS, power of two
+#define AUTH_WAYS       4
+#define AUTH_STRIPES    16    // one lock per stripe of sets
+#define AUTH_MAX_FAILS  5     // failures tolerated per window
+#define AUTH_WINDOW_S   60
+#define AUTH_BACKOFF_S  60
+
+#define BATCH_MAX       32    // steps per BEGIN ... COMMIT
+
+// Idempotency-key dedup cache
+#define DEDUP_SESSIONS  128   // cache records (attached or awaiting resumption)
+#define DEDUP_KEYS      32    // remembered keys per record (ring)
+#define DEDUP_KEY_LEN   32
+#define DEDUP_TTL_S     300   // idle records older than this may be reused
+
+// Roster
+#define LIST_DEFAULT    100   // LIST USERS page size when no limit is given
+#define LIST_MAX        1000
+#define ROSTER_RTT_S    10    // min seconds between RTT refreshes of a roster entry
+
+// Admission control
+#define ADMIT_SLOTS     4096  // per-IP counter table (open addressing), power of two
+#define ADMIT_PROBE     16    // max probe length; a full neighbourhood rejects the peer
+
+#define TICK_BUCKETS    24    // tick lateness histogram, powers of two up to ~8 s
+
+// Adaptive telemetry rate (cfg.period_max > 0)
+#define RATE_FRAME_MAX  (TLM_LINE_MAX+DRV_LINE_MAX)   // bytes one delivery may add to the queue
+#define RATE_STEPS      64    // additive increase: good deliveries from the min to the max rate
+#define RATE_NOTIFY     0.25  // a RATE notice once the period moved by more than this fraction,
+#define RATE_NOTIFY_MS  1000  // but at most one per second
+
+// External ingestion (UDP, binary TLM frames; several frames may share a datagram)
+#define INGEST_BATCH    64    // datagrams per recvmmsg()
+#define INGEST_DGRAM    1472  // max datagram payload read (Ethernet MTU minus headers)
+
+typedef enum { ROLE_OBSERVER=0, ROLE_ADMIN=1 } role_t;
+typedef enum { DIR_N=0, DIR_E=1, DIR_S=2, DIR_W=3 } dir_t;
+typedef enum { OP_NONE=-1, OP_SPEED_UP=0, OP_SLOW_DOWN, OP_TURN_LEFT, OP_TURN_RIGHT } op_t;
+
+enum { DRV_DRAIN, DRV_RANGE, DRV_TEMP_TIME, DRV_DISTANCE, DRV_N };
+#define DRV_ALL       ((1u<<DRV_N)-1)
+#define DRV_LINE_MAX  128
+
+typedef struct {
+    int   speed;   // 0..100
+    int   battery; // 0..100
+    int   temp;    // °C
+    dir_t dir;
+} vehicle_t;
+
+struct avt_sess {
+    avt_ctx_t *ctx;             // the room the session is in
+    avt_ctx_t *home;            // the context that admitted it: owns its slot and memory charge
+    int fd; struct sockaddr_in addr; char peer[80];
+    avt_write_fn wr; void *wr_user;
+    pthread_mutex_t wmx;        // serializes replies and broadcast frames on this peer
+    avt_admit_t adm;            // AVT_ADMIT_RESERVED: must AUTH as admin before anything else
+    // Registry view of the session; written only by the owning thread
+    uint64_t id; role_t role; char name[64]; time_t since; unsigned rtt_us; time_t rtt_at;
+    tlm_fmt_t fmt; bool need_full;   // telemetry encoding; guarded by ctx->clients_mx
+    unsigned drv_mask;               // subscribed derived metrics; guarded by ctx->clients_mx
+    // Telemetry conflation (avt_session_set_ready): newest sample not yet written; guarded by wmx
+    avt_ready_fn ready; bool held; tlm_sample_t held_s; long held_dv[DRV_N];
+    // Adaptive rate in frames per tick; guarded by ctx->clients_mx (wrote: by wmx)
+    double rate, credit; int told_ms; long told_tick, q_prev; size_t wrote;
+    // BEGIN ... COMMIT: steps queued until COMMIT; bad_step is the first invalid one (-1 if none)
+    bool in_batch; int nops, bad_step; op_t ops[BATCH_MAX];
+    int dd; uint64_t dd_token;   // dedup record index/token, -1 until SESSION or first @key
+    int ros;                     // index in ctx->roster, -1 if absent; guarded by ctx->roster_mx
+    // Line assembly across avt_session_feed() calls
+    size_t inlen; bool overflow; char in[MAX_LINE];
+    struct avt_sess *next;
+};
+
+// Roster: one entry per session, updated in place on connect, disconnect, HELLO and
+// AUTH (removal moves the last entry into the hole), so every change is O(1).
+// LIST USERS copies its page out under roster_mx, never clients_mx.
+typedef struct {
+    uint64_t id; struct sockaddr_in addr; role_t role; char name[64]; time_t since; unsigned rtt_us;
+    avt_sess_t *sess;   // owner, to fix up its ros index when its entry moves
+} roster_entry_t;
+
+// Failed-AUTH entry: set k (slots k*AUTH_WAYS..) is guarded by auth_mx[k % AUTH_STRIPES]
+typedef struct { uint32_t ip; int fails; time_t first, until; } authfail_t;
+
+// Dedup records outlive their connection so a client can resume them by token
+typedef struct {
+    uint64_t token; time_t last; int next;
+    struct { char key[DEDUP_KEY_LEN]; char reply[128]; } e[DEDUP_KEYS];
+} dedup_t;
+
+// Per-IP connection count for admission control
+typedef struct { uint32_t ip; int count; } admit_t;
+
+// Derived metrics, advanced once per tick by avt_broadcast()
+static const char *const k_drv_name[DRV_N] = { "drain", "range", "temp_time", "distance" };
+typedef struct {
+    double drain;       // battery %/h, smoothed over battery changes
+    double dist_m;      // since the context was created
+    time_t temp_since;  // tick at which temp last changed
+    double at, bat_at;  // monotonic seconds of the last tick / of the last battery change
+    int    bat;         // battery level at bat_at
+    bool   have_drain, have_bat;
+} derived_t;
+
+struct avt_ctx {
+    avt_config_t cfg;
+    avt_log_fn log; void *log_user;
+    avt_clock_fn clock; void *clock_user; uint64_t seed;   // deterministic mode; seed: xorshift64 state
+    avt_record_fn rec; void *rec_user;
+    avt_room_fn room; void *room_user;   // HELLO room= resolver (avt_set_rooms)
+    avt_control_fn control; void *control_user;   // remote vehicle (avt_set_control)
+
+    pthread_mutex_t state_mx; vehicle_t veh;
+
+    pthread_mutex_t clients_mx; avt_sess_t *clients; uint64_t next_id;
+
+    pthread_mutex_t roster_mx; roster_entry_t *roster; int roster_n, roster_cap;
+
+    pthread_mutex_t auth_mx[AUTH_STRIPES]; authfail_t authfail[AUTH_SLOTS];
+    atomic_long auth_failures;    // rejected credentials
+    atomic_long auth_throttled;   // AUTH lines refused while in backoff
+
+    pthread_mutex_t dedup_mx; dedup_t *dedup;   // allocated on first use
+    atomic_long dedup_hits;
+
+    pthread_mutex_t admit_mx; admit_t admit[ADMIT_SLOTS]; int conn_general, conn_reserved;
+    atomic_long admit_rejected;
+
+    atomic_long ingest_samples, ingest_bad;   // external samples applied / rejected
+    atomic_long tlm_conflated;                // held samples replaced before the peer could take them
+    atomic_long rate_backoffs;                // adaptive-rate period doublings
+    hist_t *hist;                             // HISTORY store (cfg.hist_mem), fed by avt_broadcast
+    atomic_bool hist_ingest;                  //   ... or by avt_ingest once samples arrive
+
+    avt_ctx_t *acct;              // context whose counters and budget apply: itself, or a room's lobby
+    atomic_long mem[AVT_MEM_N];   // bytes held, by subsystem (avt_mem_t)
+    atomic_long mem_shed;         // connections and allocations refused by cfg.mem_budget
+
+    // Tick lateness reported by the driver (avt_tick_note); bucket i counts lateness < 2^i us
+    pthread_mutex_t tick_mx; long ticks, overruns, late_max_us; long late_hist[TICK_BUCKETS];
+
+    // Broadcaster state; avt_broadcast() callers serialize on bc_mx
+    pthread_mutex_t bc_mx; tlm_clock_t clk; tlm_sample_t prev; bool have_prev; derived_t drv; long bc_ticks;
+};
+
+// ---------- Utils / Logging ----------
+static void ctx_log(avt_ctx_t *ctx, const char *peer, const char *fmt, ...){
+    if (!ctx->log) return;
+    char msg[MAX_LINE+64];
+    va_list ap; va_start(ap, fmt); vsnprintf(msg, sizeof(msg), fmt, ap); va_end(ap);
+    ctx->log(ctx->log_user, peer, msg);
+}
+
+// Both clocks follow the virtual clock when one is set (avt_set_clock)
+static time_t mono_now(const avt_ctx_t *ctx){
+    if (ctx->clock) return ctx->clock(ctx->clock_user);
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return ts.tv_sec;
+}
+static time_t wall_now(const avt_ctx_t *ctx){ return ctx->clock ? ctx->clock(ctx->clock_user) : time(NULL); }
+static double mono_sec(const avt_ctx_t *ctx){
+    if (ctx->clock) return (double)ctx->clock(ctx->clock_user);
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (double)ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static const char* dir_str(dir_t d){ return (d==DIR_N?"N":d==DIR_E?"E":d==DIR_S?"S":"W"); }
+
+static int sess_write(avt_sess_t *s, const char *buf, size_t len){
+    pthread_mutex_lock(&s->wmx);
+    int rc=s->wr(s->wr_user, buf, len); s->wrote+=len;
+    pthread_mutex_unlock(&s->wmx);
+    return rc;
+}
+static void sess_printf(avt_sess_t *s, const char *fmt, ...){
+    char buf[1024];
+    va_list ap; va_start(ap, fmt); int n=vsnprintf(buf, sizeof(buf), fmt, ap); va_end(ap);
+    if (n<0) return;
+    sess_write(s, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf)-1);
+}
+
+// ---------- Memory accounting ----------
+static const char *const k_mem_name[AVT_MEM_N] = { "ctx", "sessions", "conn", "roster", "dedup", "capture", "history", "ingest" };
+
+void avt_mem_charge(avt_ctx_t *ctx, avt_mem_t kind, long bytes){ atomic_fetch_add(&ctx->acct->mem[kind], bytes); }
+
+long avt_mem_used(avt_ctx_t *ctx){
+    long used=0;
+    for (int i=0;i<AVT_MEM_N;i++) used+=atomic_load(&ctx->acct->mem[i]);
+    return used;
+}
+// What one more connection costs: the session plus the front end's share.
+static long conn_cost(const avt_ctx_t *ctx){ return (long)sizeof(avt_sess_t)+ctx->cfg.conn_mem; }
+// Whether bytes more stay within cfg.mem_budget; counts a refusal. Concurrent
+// callers may overshoot by one allocation each.
+static bool mem_fits(avt_ctx_t *ctx, long bytes){
+    ctx=ctx->acct;
+    if (!ctx->cfg.mem_budget || avt_mem_used(ctx)+bytes <= ctx->cfg.mem_budget) return true;
+    atomic_fetch_add(&ctx->mem_shed,1);
+    return false;
+}
+int avt_mem_reserve(avt_ctx_t *ctx, avt_mem_t kind, long bytes){
+    if (!mem_fits(ctx, bytes)) return 0;
+    avt_mem_charge(ctx, kind, bytes);
+    return 1;
+}
+
+// ---------- Roster ----------
+static unsigned tcp_rtt_us(int fd){
+    if (fd<0) return 0;
+    struct tcp_info ti; socklen_t l=sizeof(ti);
+    return getsockopt(fd,IPPROTO_TCP,TCP_INFO,&ti,&l)==0 ? ti.tcpi_rtt : 0;
+}
+static void roster_fill(roster_entry_t *e, avt_sess_t *c){
+    e->id=c->id; e->addr=c->addr; e->role=c->role; e->since=c->since; e->rtt_us=c->rtt_us;
+    memcpy(e->name,c->name,sizeof(e->name)); e->sess=c;
+}
+// Inserts or refreshes session c's entry, or removes it when gone.
+static void roster_update(avt_ctx_t *ctx, avt_sess_t *c, bool gone){
+    pthread_mutex_lock(&ctx->roster_mx);
+    if (gone){
+        if (c->ros>=0){
+            int last=--ctx->roster_n;
+            if (c->ros!=last){ ctx->roster[c->ros]=ctx->roster[last]; ctx->roster[c->ros].sess->ros=c->ros; }
+            c->ros=-1;
+        }
+    } else if (c->ros>=0) roster_fill(&ctx->roster[c->ros],c);
+    else {
+        if (ctx->roster_n==ctx->roster_cap){
+            int nc=ctx->roster_cap ? ctx->roster_cap*2 : 64;
+            roster_entry_t *r=realloc(ctx->roster,(size_t)nc*sizeof(*r));
+            if (!r){ pthread_mutex_unlock(&ctx->roster_mx); return; }
+            avt_mem_charge(ctx, AVT_MEM_ROSTER, (long)((size_t)(nc-ctx->roster_cap)*sizeof(*r)));
+            ctx->roster=r; ctx->roster_cap=nc;
+        }
+        c->ros=ctx->roster_n++;
+        roster_fill(&ctx->roster[c->ros],c);
+    }
+    pthread_mutex_unlock(&ctx->roster_mx);
+}
+static void registry_touch(avt_sess_t *c){
+    c->rtt_us=tcp_rtt_us(c->fd); c->rtt_at=mono_now(c->ctx);
+    roster_update(c->ctx,c,false);
+}
+static bool roster_match(const roster_entry_t *e, const char *filter){
+    if (!filter[0]) return true;
+    if (strcasecmp(filter,"ADMIN")==0)    return e->role==ROLE_ADMIN;
+    if (strcasecmp(filter,"OBSERVER")==0) return e->role==ROLE_OBSERVER;
+    return strstr(e->name,filter)!=NULL;
+}
+// LIST USERS [offset] [limit] [filter]: the page is formatted under roster_mx and sent
+// in one write. Leading numbers are offset then limit; the first other token is the filter.
+static void list_users_to(avt_sess_t *s, const char *args){
+    int off=0, lim=LIST_DEFAULT, nnum=0, n; char filter[64]="", tok[64];
+    while (sscanf(args," %63s%n",tok,&n)==1){
+        args+=n; char *e; long v=strtol(tok,&e,10);
+        if (!filter[0] && !*e && nnum<2){ if (nnum++==0) off=(int)v; else lim=(int)v; }
+        else if (!filter[0]) snprintf(filter,sizeof(filter),"%s",tok);
+    }
+    if (off<0) off=0;
+    if (lim<=0 || lim>LIST_MAX) lim=LIST_MAX;
+    avt_ctx_t *ctx=s->ctx;
+    pthread_mutex_lock(&ctx->roster_mx);
+    int total=0;
+    for(int i=0;i<ctx->roster_n;i++) if(roster_match(&ctx->roster[i],filter)) total++;
+    int shown = total>off ? (total-off<lim ? total-off : lim) : 0;
+    size_t cap=64+(size_t)shown*192, len=0;
+    char *buf=malloc(cap);
+    if (!buf){ pthread_mutex_unlock(&ctx->roster_mx); sess_printf(s,"ERR busy\n"); return; }
+    len+=(size_t)snprintf(buf,cap,"OK %d users total=%d\n", shown, total);
+    for(int i=0, k=0; i<ctx->roster_n && k<off+shown; i++){
+        const roster_entry_t *e=&ctx->roster[i];
+        if (!roster_match(e,filter) || k++ < off) continue;
+        char ip[64]; inet_ntop(AF_INET,&e->addr.sin_addr,ip,sizeof(ip));
+        len+=(size_t)snprintf(buf+len,cap-len,"USER %s:%u ROLE=%s SINCE=%lld RTT_US=%u NAME=%s\n",
+                              ip, ntohs(e->addr.sin_port), e->role==ROLE_ADMIN?"ADMIN":"OBSERVER",
+                              (long long)e->since, e->rtt_us, e->name[0]?e->name:"-");
+    }
+    pthread_mutex_unlock(&ctx->roster_mx);
+    sess_write(s,buf,len);
+    free(buf);
+}
+
+// ---------- AUTH throttling ----------
+static unsigned auth_set(uint32_t ip){ return (ip * 2654435761u) >> 24; } // top 8 bits -> AUTH_SLOTS/AUTH_WAYS sets
+static int auth_used(const authfail_t *e){ return e->fails || e->until; }
+
+// The peer's entry in set k, or NULL; caller holds the stripe lock.
+static authfail_t *auth_find(avt_ctx_t *ctx, unsigned k, uint32_t ip){
+    authfail_t *set=&ctx->authfail[k*AUTH_WAYS];
+    for (int w=0;w<AUTH_WAYS;w++) if (auth_used(&set[w]) && set[w].ip==ip) return &set[w];
+    return NULL;
+}
+
+// True if the peer is in backoff; such AUTH lines are answered without parsing or logging.
+static int auth_blocked(avt_ctx_t *ctx, uint32_t ip){
+    unsigned k=auth_set(ip); int blocked=0;
+    pthread_mutex_lock(&ctx->auth_mx[k % AUTH_STRIPES]);
+    authfail_t *e=auth_find(ctx,k,ip);
+    if (e && e->until > mono_now(ctx)) blocked=1;
+    pthread_mutex_unlock(&ctx->auth_mx[k % AUTH_STRIPES]);
+    if (blocked) atomic_fetch_add(&ctx->auth_throttled,1);
+    return blocked;
+}
+// Records an AUTH outcome; returns 1 when this failure puts the peer into backoff.
+// A new peer takes a free way, else the one with the oldest window that is not in
+// backoff: an active backoff is never evicted. If all ways are backing off, the
+// failure is counted but not tracked.
+static int auth_record(avt_ctx_t *ctx, uint32_t ip, int ok){
+    unsigned k=auth_set(ip); int tripped=0; time_t now=mono_now(ctx);
+    pthread_mutex_lock(&ctx->auth_mx[k % AUTH_STRIPES]);
+    authfail_t *e=auth_find(ctx,k,ip);
+    if (ok){ if (e && e->until <= now) memset(e,0,sizeof(*e)); }
+    else {
+        if (!e){
+            authfail_t *set=&ctx->authfail[k*AUTH_WAYS];
+            for (int w=0;w<AUTH_WAYS;w++){
+                if (!auth_used(&set[w])){ e=&set[w]; break; }
+                if (set[w].until <= now && (!e || set[w].first < e->first)) e=&set[w];
+            }
+            if (e){ e->ip=ip; e->fails=0; e->first=now; e->until=0; }
+        } else if (e->until <= now && now - e->first > AUTH_WINDOW_S){ e->fails=0; e->first=now; }
+        if (e && e->until <= now && ++e->fails >= AUTH_MAX_FAILS){ e->until=now+AUTH_BACKOFF_S; e->fails=0; e->first=now; tripped=1; }
+    }
+    pthread_mutex_unlock(&ctx->auth_mx[k % AUTH_STRIPES]);
+    if (!ok) atomic_fetch_add(&ctx->auth_failures,1);
+    return tripped;
+}
+
+// ---------- Idempotency keys ----------
+// Splits "@<key> <cmd>" into key and command; returns -1 on a malformed key.
+static int split_key(char **line, char *key, size_t ksz){
+    char *p=*line; key[0]='\0';
+    if (*p!='@') return 0;
+    size_t n=strcspn(p+1," ");
+    if (n==0 || n>=ksz || p[1+n]!=' ') return -1;
+    memcpy(key,p+1,n); key[n]='\0';
+    *line = p+1+n+1;
+    return 0;
+}
+// Claims a free or stale record; caller holds dedup_mx. Returns -1 if every record is live.
+static int dedup_alloc(avt_sess_t *s){
+    avt_ctx_t *ctx=s->ctx;
+    if (!ctx->dedup){
+        long bytes=(long)(DEDUP_SESSIONS*sizeof(dedup_t));
+        if (!mem_fits(ctx, bytes) || !(ctx->dedup=calloc(DEDUP_SESSIONS,sizeof(dedup_t)))) return -1;
+        avt_mem_charge(ctx, AVT_MEM_DEDUP, bytes);
+    }
+    time_t now=mono_now(ctx); int best=-1;
+    for(int i=0;i<DEDUP_SESSIONS;i++){
+        if (ctx->dedup[i].token==0){ best=i; break; }
+        if (now - ctx->dedup[i].last > DEDUP_TTL_S && (best<0 || ctx->dedup[i].last < ctx->dedup[best].last)) best=i;
+    }
+    if (best<0) return -1;
+    uint64_t tok=0;
+    while(tok==0){
+        if (ctx->clock){ ctx->seed^=ctx->seed<<13; ctx->seed^=ctx->seed>>7; ctx->seed^=ctx->seed<<17; tok=ctx->seed; }
+        else if(getrandom(&tok,sizeof(tok),0)!=sizeof(tok)) tok=((uint64_t)now<<32) ^ (uint64_t)(uintptr_t)s ^ (uint64_t)best;
+    }
+    memset(&ctx->dedup[best],0,sizeof(ctx->dedup[best]));
+    ctx->dedup[best].token=tok; ctx->dedup[best].last=now;
+    s->dd=best; s->dd_token=tok;
+    return best;
+}
+static dedup_t *dedup_of(avt_sess_t *s){
+    dedup_t *tab=s->ctx->dedup;
+    if (tab && s->dd>=0 && tab[s->dd].token==s->dd_token) return &tab[s->dd];
+    return dedup_alloc(s)>=0 ? &s->ctx->dedup[s->dd] : NULL;
+}
+// SESSION [<token>]: reply carries the token to present after a reconnect.
+static void session_cmd(avt_sess_t *s, const char *arg, char *reply, size_t rsz){
+    avt_ctx_t *ctx=s->ctx;
+    pthread_mutex_lock(&ctx->dedup_mx);
+    if (*arg){
+        uint64_t tok=strtoull(arg,NULL,16); int found=-1;
+        for(int i=0;ctx->dedup && i<DEDUP_SESSIONS && tok;i++) if(ctx->dedup[i].token==tok){ found=i; break; }
+        if (found<0) snprintf(reply,rsz,"ERR unknown session");
+        else { s->dd=found; s->dd_token=tok; ctx->dedup[found].last=mono_now(ctx);
+               snprintf(reply,rsz,"OK session=%016llx resumed", (unsigned long long)tok); }
+    } else {
+        dedup_t *d=dedup_of(s);
+        if (!d) snprintf(reply,rsz,"ERR busy");
+        else snprintf(reply,rsz,"OK session=%016llx", (unsigned long long)d->token);
+    }
+    pthread_mutex_unlock(&ctx->dedup_mx);
+}
+// Keyed mutations run between dedup_begin and dedup_end with dedup_mx held, so a key
+// is applied at most once even if a resumed and a stale connection race on it.
+// Returns 1 with the reply to send (lock already released): the cached one on a hit,
+// or ERR busy when no record can be claimed, since the key could not be remembered.
+static int dedup_begin(avt_sess_t *s, const char *key, char *reply, size_t rsz){
+    if (!key[0]) return 0;
+    pthread_mutex_lock(&s->ctx->dedup_mx);
+    dedup_t *d=dedup_of(s);
+    if (!d){
+        pthread_mutex_unlock(&s->ctx->dedup_mx);
+        snprintf(reply,rsz,"ERR busy");
+        return 1;
+    }
+    d->last=mono_now(s->ctx);
+    for(int i=0;i<DEDUP_KEYS;i++) if(strcmp(d->e[i].key,key)==0){
+        snprintf(reply,rsz,"%s",d->e[i].reply);
+        pthread_mutex_unlock(&s->ctx->dedup_mx);
+        atomic_fetch_add(&s->ctx->dedup_hits,1);
+        return 1;
+    }
+    return 0;
+}
+static void dedup_cancel(avt_sess_t *s, const char *key){ if (key[0]) pthread_mutex_unlock(&s->ctx->dedup_mx); }
+// Transient failures are not remembered: nothing was applied, so a retry must run again.
+static bool reply_transient(const char *reply){
+    return strcmp(reply,"ERR busy")==0 || strcmp(reply,"ERR unavailable")==0;
+}
+static void dedup_end(avt_sess_t *s, const char *key, const char *reply){
+    if (!key[0]) return;
+    dedup_t *tab=s->ctx->dedup;
+    if (tab && s->dd>=0 && tab[s->dd].token==s->dd_token && !reply_transient(reply)){
+        dedup_t *d=&tab[s->dd];
+        snprintf(d->e[d->next].key,sizeof(d->e[0].key),"%s",key);
+        snprintf(d->e[d->next].reply,sizeof(d->e[0].reply),"%s",reply);
+        d->next=(d->next+1)%DEDUP_KEYS;
+    }
+    pthread_mutex_unlock(&s->ctx->dedup_mx);
+}
+
+// ---------- Admission control ----------
+// Finds ip's counter, or the slot to insert it at; NULL if the probe window is exhausted.
+// Caller holds admit_mx. Zero-count slots are reused, but only after the whole
+// window was checked for an existing entry of the same ip.
+static admit_t *admit_slot(avt_ctx_t *ctx, uint32_t ip){
+    unsigned h=(ip * 2654435761u) >> 20; admit_t *free_slot=NULL;
+    for(int i=0;i<ADMIT_PROBE;i++){
+        admit_t *e=&ctx->admit[(h+(unsigned)i) & (ADMIT_SLOTS-1)];
+        if (e->count>0 && e->ip==ip) return e;
+        if (e->count==0 && !free_slot) free_slot=e;
+    }
+    if (free_slot) free_slot->ip=ip;
+    return free_slot;
+}
+avt_admit_t avt_admit(avt_ctx_t *ctx, uint32_t ip){
+    avt_admit_t r=AVT_ADMIT_REFUSED;
+    if (!mem_fits(ctx, conn_cost(ctx))){ atomic_fetch_add(&ctx->admit_rejected,1); return r; }
+    pthread_mutex_lock(&ctx->admit_mx);
+    admit_t *e=admit_slot(ctx,ip);
+    if (e && e->count < ctx->cfg.max_per_ip){
+        if (ctx->conn_general < ctx->cfg.max_conn){ ctx->conn_general++; r=AVT_ADMIT_GENERAL; }
+        else if (ctx->conn_reserved < ctx->cfg.admin_reserve){ ctx->conn_reserved++; r=AVT_ADMIT_RESERVED; }
+        if (r!=AVT_ADMIT_REFUSED) e->count++;
+    }
+    pthread_mutex_unlock(&ctx->admit_mx);
+    if (r==AVT_ADMIT_REFUSED) atomic_fetch_add(&ctx->admit_rejected,1);
+    else avt_mem_charge(ctx, AVT_MEM_CONN, ctx->cfg.conn_mem);
+    return r;
+}
+void avt_release(avt_ctx_t *ctx, uint32_t ip, avt_admit_t adm){
+    if (adm!=AVT_ADMIT_GENERAL && adm!=AVT_ADMIT_RESERVED) return;
+    pthread_mutex_lock(&ctx->admit_mx);
+    admit_t *e=admit_slot(ctx,ip);
+    if (e && e->count>0) e->count--;
+    if (adm==AVT_ADMIT_RESERVED) ctx->conn_reserved--; else ctx->conn_general--;
+    pthread_mutex_unlock(&ctx->admit_mx);
+    avt_mem_charge(ctx, AVT_MEM_CONN, -ctx->cfg.conn_mem);
+}
+
+// ---------- Tick jitter ----------
+void avt_tick_note(avt_ctx_t *ctx, long late_us, int overrun){
+    int b=0; while (b<TICK_BUCKETS-1 && late_us >= (1L<<b)) b++;
+    pthread_mutex_lock(&ctx->tick_mx);
+    ctx->ticks++; ctx->late_hist[b]++;
+    if (overrun) ctx->overruns++;
+    if (late_us > ctx->late_max_us) ctx->late_max_us=late_us;
+    pthread_mutex_unlock(&ctx->tick_mx);
+}
+// Upper bound of the bucket holding the 99th percentile; caller holds tick_mx.
+static long tick_p99_us(const avt_ctx_t *ctx){
+    long seen=0, want=ctx->ticks - ctx->ticks/100;
+    for (int b=0;b<TICK_BUCKETS;b++){ seen+=ctx->late_hist[b]; if (seen>=want && seen) return 1L<<b; }
+    return 0;
+}
+
+// Admission and memory figures are the admitting context's (process-wide with
+// rooms); everything else is the session's room.
+static void stats_to(avt_sess_t *s){
+    avt_ctx_t *ctx=s->ctx, *home=s->home, *acct=ctx->acct;
+    char mem[256]; int mn=0;
+    hist_stats_t hs={0}; if (ctx->hist) hist_stats(ctx->hist, &hs);
+    for (int i=0;i<AVT_MEM_N;i++) mn+=snprintf(mem+mn, sizeof(mem)-(size_t)mn, " mem_%s=%ld", k_mem_name[i], atomic_load(&acct->mem[i]));
+    pthread_mutex_lock(&home->admit_mx);
+    int general=home->conn_general, reserved=home->conn_reserved;
+    pthread_mutex_unlock(&home->admit_mx);
+    pthread_mutex_lock(&ctx->tick_mx);
+    long ticks=ctx->ticks, overruns=ctx->overruns, late_max=ctx->late_max_us, late_p99=tick_p99_us(ctx);
+    pthread_mutex_unlock(&ctx->tick_mx);
+    sess_printf(s, "OK stats auth_max_fails=%d auth_window=%d auth_backoff=%d auth_failures=%ld auth_throttled=%ld"
+                   " dedup_sessions=%d dedup_keys=%d dedup_hits=%ld"
+                   " conn=%d/%d admin_reserve=%d/%d max_per_ip=%d admit_rejected=%ld"
+                   " ingest_samples=%ld ingest_bad=%ld tlm_conflated=%ld rate_backoffs=%ld"
+                   " ticks=%ld tick_late_p99_us=%ld tick_late_max_us=%ld tick_overruns=%ld"
+                   " hist_raw=%ld hist_rollups=%ld hist_spilled=%ld hist_dropped=%ld hist_rollups_dropped=%ld"
+                   " mem_used=%ld mem_budget=%ld mem_per_conn=%ld mem_shed=%ld%s\n",
+                AUTH_MAX_FAILS, AUTH_WINDOW_S, AUTH_BACKOFF_S,
+                atomic_load(&ctx->auth_failures), atomic_load(&ctx->auth_throttled),
+                DEDUP_SESSIONS, DEDUP_KEYS, atomic_load(&ctx->dedup_hits),
+                general, home->cfg.max_conn, reserved, home->cfg.admin_reserve, home->cfg.max_per_ip,
+                atomic_load(&home->admit_rejected),
+                atomic_load(&ctx->ingest_samples), atomic_load(&ctx->ingest_bad), atomic_load(&ctx->tlm_conflated),
+                atomic_load(&ctx->rate_backoffs),
+                ticks, late_p99, late_max, overruns,
+                hs.raw, hs.rollups, hs.spilled, hs.dropped, hs.rollups_dropped,
+                avt_mem_used(acct), acct->cfg.mem_budget, conn_cost(home), atomic_load(&acct->mem_shed), mem);
+}
+
+// ---------- History ----------
+#define HIST_OUT  16384   // reply bytes gathered per write
+
+typedef struct { avt_sess_t *s; tlm_clock_t clk; long raw, rollups; int err; size_t len; char buf[HIST_OUT]; } hist_out_t;
+
+static int hist_flush(hist_out_t *o){
+    if (o->len && sess_write(o->s, o->buf, o->len)<0) o->err=1;
+    o->len=0;
+    return o->err;
+}
+
+#define HRU_INT(p, r, name)  ((p) += sprintf((p), ";" #name "=%d/%d/%d", (r)->name##_min, \
+                              (int)(((r)->name##_sum + (r)->n/2) / (r)->n), (r)->name##_max))
+#define HRU_DIR(p, r, name)  ((p) += sprintf((p), ";" #name "=%c", (r)->name))
+#define HRU_TIME(p, r, name) do { time_t t_=(time_t)(r)->name; struct tm tm_; localtime_r(&t_,&tm_); \
+                                  (p) += strftime((p), 32, ";" #name "=%Y-%m-%d %H:%M:%S", &tm_); } while(0)
+
+static int hist_on_rollup(void *user, const hist_rollup_t *r){
+    hist_out_t *o=user;
+    if (o->len+TLM_LINE_MAX*2 > sizeof(o->buf) && hist_flush(o)) return 1;
+    char *p=o->buf+o->len;
+    p += sprintf(p, "HRU n=%d", r->n);
+#define TLM_FIELD(name, kind) HRU_##kind(p, r, name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    *p++='\n';
+    o->len=(size_t)(p-o->buf); o->rollups++;
+    return 0;
+}
+
+static int hist_on_sample(void *user, const tlm_sample_t *smp){
+    hist_out_t *o=user;
+    if (o->len+TLM_LINE_MAX > sizeof(o->buf) && hist_flush(o)) return 1;
+    char *line=o->buf+o->len;
+    o->len+=tlm_encode_text(&o->clk, line, smp); memcpy(line, "HST", 3);
+    o->raw++;
+    return 0;
+}
+
+static int hist_on_raw(void *user, const hist_cols_t *c, int i0, int i1){
+    for (int i=i0;i<i1;i++){
+        tlm_sample_t smp;
+#define TLM_FIELD(name, kind) smp.name=c->name[i];
+#include "tlm_schema.def"
+#undef TLM_FIELD
+        if (hist_on_sample(user, &smp)) return 1;
+    }
+    return 0;
+}
+
+// HISTORY <from> [<to>] [points=<n>] [field=<f>]: times <= 0 are seconds before now;
+// points= downsamples the raw samples by field (default speed) with LTTB.
+static void history_to(avt_sess_t *s, const char *args){
+    avt_ctx_t *ctx=s->ctx;
+    if (!ctx->hist){ sess_printf(s,"ERR history off\n"); return; }
+    long long t[2]={0,0}; int nt=0, points=0, field=TLM_F_speed, n;
+    char tok[32];
+    while (sscanf(args, " %31s%n", tok, &n)==1){
+        args+=n; char *e;
+        if (strncmp(tok,"points=",7)==0){ points=(int)strtol(tok+7,&e,10); if (*e || points<3){ sess_printf(s,"ERR points must be >= 3\n"); return; } }
+        else if (strncmp(tok,"field=",6)==0){ if ((field=hist_field(tok+6))<0){ sess_printf(s,"ERR bad field\n"); return; } }
+        else if (nt<2){ t[nt++]=strtoll(tok,&e,10); if (*e) nt=-9; }
+        else nt=-9;
+        if (nt<0) break;
+    }
+    if (nt<1){ sess_printf(s,"ERR usage: HISTORY <from> [<to>] [points=<n>] [field=<f>]\n"); return; }
+    time_t now=wall_now(ctx);
+    long long from = t[0]<=0 ? t[0]+now : t[0], to = t[1]<=0 ? t[1]+now : t[1];
+    if (from>to){ sess_printf(s,"ERR bad range\n"); return; }
+    long rows = points ? hist_count(ctx->hist, from, to) : 0;
+    hist_out_t *o=malloc(sizeof(*o));
+    hist_lttb_t *lt = rows && o ? hist_lttb_new(rows, points, field, hist_on_sample, o) : NULL;
+    if (!o || (rows && !lt)){ free(o); sess_printf(s,"ERR out of memory\n"); return; }
+    memset(o, 0, offsetof(hist_out_t, buf)); o->s=s;
+    int rc=hist_query(ctx->hist, from, to, hist_on_rollup, lt ? hist_lttb_feed : hist_on_raw, lt ? (void*)lt : (void*)o);
+    if (lt) hist_lttb_end(lt);
+    if (!hist_flush(o)){
+        char scanned[40]=""; if (lt) snprintf(scanned,sizeof(scanned)," scanned=%ld", hist_lttb_scanned(lt));
+        if (rc<0) sess_printf(s,"ERR history read failed raw=%ld rollups=%ld%s\n", o->raw, o->rollups, scanned);
+        else sess_printf(s,"OK history raw=%ld rollups=%ld%s\n", o->raw, o->rollups, scanned);
+    }
+    hist_lttb_free(lt); free(o);
+}
+
+// ---------- Vehicle control ----------
+static op_t parse_op(const char *p){
+    if(strcmp(p,"SPEED UP")==0)   return OP_SPEED_UP;
+    if(strcmp(p,"SLOW DOWN")==0)  return OP_SLOW_DOWN;
+    if(strcmp(p,"TURN LEFT")==0)  return OP_TURN_LEFT;
+    if(strcmp(p,"TURN RIGHT")==0) return OP_TURN_RIGHT;
+    return OP_NONE;
+}
+// Applies one step to v (caller holds state_mx or owns v); v is untouched on failure.
+static int veh_apply(vehicle_t *v, op_t op, char *why, size_t wsz){
+    if (op==OP_TURN_LEFT || op==OP_TURN_RIGHT){
+        v->dir = (dir_t)(((int)v->dir + (op==OP_TURN_LEFT?3:1)) % 4);
+        snprintf(why,wsz,"dir=%s", dir_str(v->dir)); return 1;
+    }
+    if (v->battery < 15) { snprintf(why,wsz,"battery low"); return 0; }
+    int ns = v->speed + (op==OP_SPEED_UP?+5:-5);
+    if (ns < 0)   { snprintf(why,wsz,"min speed"); return 0; }
+    if (ns > 100) { snprintf(why,wsz,"max speed"); return 0; }
+    v->speed = ns; snprintf(why,wsz,"speed=%d", v->speed); return 1;
+}
+static int apply_op(avt_ctx_t *ctx, op_t op, char *why, size_t wsz){
+    pthread_mutex_lock(&ctx->state_mx);
+    int ok=veh_apply(&ctx->veh, op, why, wsz);
+    pthread_mutex_unlock(&ctx->state_mx);
+    return ok;
+}
+// Runs all steps on a copy under one state_mx hold, so no telemetry tick sees a
+// partial batch; the copy is published only if every step succeeds.
+static void apply_batch(avt_ctx_t *ctx, const op_t *ops, int n, char *reply, size_t rsz){
+    char why[64]; int failed=-1;
+    pthread_mutex_lock(&ctx->state_mx);
+    vehicle_t v=ctx->veh;
+    for(int i=0;i<n && failed<0;i++) if(!veh_apply(&v,ops[i],why,sizeof(why))) failed=i;
+    if (failed<0) ctx->veh=v;
+    pthread_mutex_unlock(&ctx->state_mx);
+    if (failed<0) snprintf(reply,rsz,"OK batch n=%d speed=%d dir=%s", n, v.speed, dir_str(v.dir));
+    else snprintf(reply,rsz,"ERR batch step=%d %s", failed+1, why);
+}
+
+// avt_control_fn step letters, indexed by op_t
+static const char k_op_code[]="UDLR";
+
+// Runs a single step (batch=0) or a committed batch on ctx's own vehicle.
+static void control_local(avt_ctx_t *ctx, const op_t *ops, int n, int batch, char *reply, size_t rsz){
+    if (batch){ apply_batch(ctx, ops, n, reply, rsz); return; }
+    char why[64]; int ok=apply_op(ctx, ops[0], why, sizeof(why));
+    snprintf(reply,rsz,"%s %s", ok?"OK":"ERR", why);
+}
+// Same, on the vehicle this context controls: its own or the one behind avt_set_control.
+static void control_run(avt_ctx_t *ctx, const op_t *ops, int n, int batch, char *reply, size_t rsz){
+    if (!ctx->control){ control_local(ctx, ops, n, batch, reply, rsz); return; }
+    char steps[BATCH_MAX+1];
+    for(int i=0;i<n;i++) steps[i]=k_op_code[ops[i]];
+    steps[n]='\0';
+    ctx->control(ctx->control_user, steps, batch, reply, rsz);
+}
+
+int avt_control(avt_ctx_t *ctx, const char *steps, int batch, char *reply, size_t rsz){
+    op_t ops[BATCH_MAX]; int n=0;
+    for(; steps[n]; n++){
+        const char *c=strchr(k_op_code, steps[n]);
+        if (!c || n==BATCH_MAX) return -1;
+        ops[n]=(op_t)(c-k_op_code);
+    }
+    if (!n || (!batch && n>1)) return -1;
+    control_local(ctx, ops, n, batch, reply, rsz);
+    return 0;
+}
+
+void avt_step(avt_ctx_t *ctx){
+    pthread_mutex_lock(&ctx->state_mx);
+    vehicle_t *v=&ctx->veh;
+    if (v->speed>0 && v->battery>0) v->battery -= (v->speed>=60?2:1);
+    if (v->battery < 0) v->battery = 0;
+    if (v->speed>70 && v->temp<80) v->temp++; else if (v->temp>35) v->temp--;
+    pthread_mutex_unlock(&ctx->state_mx);
+}
+
+void avt_sample(avt_ctx_t *ctx, tlm_sample_t *out, time_t now){
+    pthread_mutex_lock(&ctx->state_mx);
+    out->speed=ctx->veh.speed; out->battery=ctx->veh.battery; out->temp=ctx->veh.temp;
+    out->dir=dir_str(ctx->veh.dir)[0];
+    pthread_mutex_unlock(&ctx->state_mx);
+    out->ts=now;
+}
+
+static int dir_of(char c){ return c=='N'?DIR_N:c=='E'?DIR_E:c=='S'?DIR_S:c=='W'?DIR_W:-1; }
+
+void avt_ingest(avt_ctx_t *ctx, const tlm_sample_t *s, size_t n){
+    const tlm_sample_t *last=NULL; long bad=0, mem=0;
+    for(size_t i=0;i<n;i++){
+        if (dir_of(s[i].dir)<0){ bad++; continue; }
+        last=&s[i];
+        if (ctx->hist) mem+=hist_add(ctx->hist, last);
+    }
+    if (last){
+        pthread_mutex_lock(&ctx->state_mx);
+        ctx->veh.speed=last->speed; ctx->veh.battery=last->battery; ctx->veh.temp=last->temp;
+        ctx->veh.dir=(dir_t)dir_of(last->dir);
+        pthread_mutex_unlock(&ctx->state_mx);
+        if (ctx->hist){ atomic_store(&ctx->hist_ingest,true); avt_mem_charge(ctx, AVT_MEM_HISTORY, mem); }
+    }
+    atomic_fetch_add(&ctx->ingest_samples,(long)n-bad);
+    if (bad) atomic_fetch_add(&ctx->ingest_bad,bad);
+}
+
+struct avt_ingest_buf {
+    char dgram[INGEST_BATCH][INGEST_DGRAM];
+    tlm_sample_t smp[256];
+    struct mmsghdr msg[INGEST_BATCH]; struct iovec iov[INGEST_BATCH];
+    struct sockaddr_in src[INGEST_BATCH];
+};
+
+avt_ingest_buf_t *avt_ingest_buf_new(avt_ctx_t *ctx){
+    avt_ingest_buf_t *b=malloc(sizeof(*b));
+    if (!b) return NULL;
+    avt_mem_charge(ctx, AVT_MEM_INGEST, (long)sizeof(*b));
+    return b;
+}
+
+void avt_ingest_buf_free(avt_ctx_t *ctx, avt_ingest_buf_t *b){
+    if (!b) return;
+    avt_mem_charge(ctx, AVT_MEM_INGEST, -(long)sizeof(*b));
+    free(b);
+}
+
+// Only full frames are accepted: a delta from an agent depends on a datagram that may be lost.
+int avt_ingest_udp(avt_ctx_t *ctx, int fd, uint32_t from, avt_ingest_buf_t *b){
+    for(int i=0;i<INGEST_BATCH;i++){
+        b->iov[i]=(struct iovec){ .iov_base=b->dgram[i], .iov_len=INGEST_DGRAM };
+        b->msg[i]=(struct mmsghdr){ .msg_hdr={ .msg_name=&b->src[i], .msg_namelen=sizeof(b->src[i]),
+                                               .msg_iov=&b->iov[i], .msg_iovlen=1 } };
+    }
+    int got=recvmmsg(fd,b->msg,INGEST_BATCH,MSG_WAITFORONE,NULL);
+    if (got<0) return (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR) ? 0 : -1;
+    size_t n=0, total=0; long bad=0;
+    for(int i=0;i<got;i++){
+        const char *p=b->dgram[i]; size_t left=b->msg[i].msg_len;
+        if (from!=INADDR_ANY && b->src[i].sin_addr.s_addr!=from){ bad++; continue; }   // not the agent
+        while(left){
+            int k=tlm_decode_bin(p,left,&b->smp[n]);
+            if (k<=0 || p[1]!='F'){ bad++; break; }   // rest of the datagram is unusable
+            p+=k; left-=(size_t)k;
+            if (++n==sizeof(b->smp)/sizeof(b->smp[0])){ avt_ingest(ctx,b->smp,n); total+=n; n=0; }
+        }
+    }
+    if (bad) atomic_fetch_add(&ctx->ingest_bad,bad);
+    if (n) avt_ingest(ctx,b->smp,n);
+    return (int)(total+n);
+}
+
+// ---------- Derived metrics ----------
+static long rnd(double x){ return (long)(x<0 ? x-0.5 : x+0.5); }
+
+// Advances the derived state from prev to cur (caller holds bc_mx, prev not yet replaced).
+// The battery moves in whole percents, once per model step at most, so drain is
+// measured between two battery changes; while it holds, less than 1% has gone
+// since the last change, which bounds the drain and lets it decay to 0 at rest.
+static void derive(avt_ctx_t *ctx, const tlm_sample_t *cur, long v[DRV_N]){
+    derived_t *d=&ctx->drv; const tlm_sample_t *prev=&ctx->prev;
+    double t=mono_sec(ctx), dt = ctx->have_prev ? t - d->at : 0;
+    d->at=t;
+    if (!d->have_bat || cur->battery > d->bat){ d->bat=cur->battery; d->bat_at=t; d->have_bat=true; }   // start, or recharged
+    else if (cur->battery < d->bat && t > d->bat_at){
+        double inst=(double)(d->bat - cur->battery)*3600.0/(t - d->bat_at);
+        d->drain = d->have_drain ? 0.7*d->drain + 0.3*inst : inst; d->have_drain=true;
+        d->bat=cur->battery; d->bat_at=t;
+    } else if (d->have_drain && t - d->bat_at > 3600.0/d->drain) d->drain=3600.0/(t - d->bat_at);
+    if (dt>0) d->dist_m += (double)(prev->speed + cur->speed)/2.0/3.6*dt;   // km/h, trapezoid over the tick
+    if (!ctx->have_prev || cur->temp!=prev->temp) d->temp_since=cur->ts;
+    v[DRV_DRAIN]=rnd(d->drain);
+    v[DRV_RANGE]=d->drain>0.05 ? rnd((double)cur->battery/d->drain*cur->speed) : -1;   // -1: not draining
+    v[DRV_TEMP_TIME]=(long)(cur->ts - d->temp_since);
+    v[DRV_DISTANCE]=rnd(d->dist_m);
+}
+
+static size_t drv_encode(char *out, const long v[DRV_N], unsigned mask){
+    size_t n=3; char sep=' ';
+    memcpy(out,"DRV",3);
+    for(int i=0;i<DRV_N;i++) if(mask>>i&1){
+        n+=(size_t)snprintf(out+n,DRV_LINE_MAX-n,"%c%s=%ld",sep,k_drv_name[i],v[i]); sep=';';
+    }
+    out[n++]='\n';
+    return n;
+}
+
+// Parses "ALL", "OFF" or a comma-separated list of metric names; -1 on an unknown name.
+static int drv_parse(const char *p){
+    if (strcasecmp(p,"ALL")==0) return DRV_ALL;
+    if (strcasecmp(p,"OFF")==0) return 0;
+    unsigned mask=0;
+    while(*p){
+        size_t n=strcspn(p,","); int f=-1;
+        for(int i=0;i<DRV_N;i++) if(strlen(k_drv_name[i])==n && strncasecmp(p,k_drv_name[i],n)==0) f=i;
+        if (f<0) return -1;
+        mask|=1u<<f; p+=n; if(*p==',') p++;
+    }
+    return mask ? (int)mask : -1;
+}
+
+// ---------- Telemetry ----------
+// Writes the held sample as a full frame (deltas need a base the peer may have
+// missed) plus the subscribed DRV line; caller holds s->wmx.
+static void held_flush(avt_sess_t *s){
+    char out[TLM_LINE_MAX+DRV_LINE_MAX]; tlm_clock_t clk={0};
+    size_t n = s->fmt==TLM_FMT_TEXT ? tlm_encode_text(&clk, out, &s->held_s) : tlm_encode_bin(out, &s->held_s);
+    if (s->drv_mask) n+=drv_encode(out+n, s->held_dv, s->drv_mask);
+    s->held=false;
+    s->wr(s->wr_user, out, n); s->wrote+=n;
+}
+
+// Conflating sessions: while the peer is not ready, or a sample is already held,
+// the tick's sample replaces the held one instead of being written. Returns
+// false when the regular write path should run.
+static bool tlm_conflate(avt_sess_t *c, const tlm_sample_t *cur, const long dv[DRV_N]){
+    pthread_mutex_lock(&c->wmx);
+    bool ready=c->ready(c->wr_user), take=c->held || !ready;
+    if (take){
+        if (c->held) atomic_fetch_add(&c->ctx->tlm_conflated,1);
+        c->held=true; c->held_s=*cur; memcpy(c->held_dv, dv, sizeof(c->held_dv));
+        if (ready) held_flush(c);
+    }
+    pthread_mutex_unlock(&c->wmx);
+    return take;
+}
+
+// AIMD on the delivery rate, evaluated at each delivery from the socket's send
+// queue (SIOCOUTQ: unsent + unacked bytes) and RTT. A peer keeping up has at
+// most one frame queued plus what its RTT keeps in flight; above that the rate
+// halves (down to 1/period_max), and once the peer drained everything written
+// since the last delivery it grows by 1/RATE_STEPS of the range (up to
+// 1/period_min). In-process sessions (fd -1) never adapt.
+static void rate_adapt(avt_ctx_t *ctx, avt_sess_t *c){
+    int q;
+    if (c->fd<0 || ioctl(c->fd, SIOCOUTQ, &q)<0) return;
+    pthread_mutex_lock(&c->wmx); long wrote=(long)c->wrote; c->wrote=0; pthread_mutex_unlock(&c->wmx);
+    long drained=wrote-(q-c->q_prev); c->q_prev=q;
+    double lo=1.0/ctx->cfg.period_max, hi=1.0/ctx->cfg.period_min;
+    double period_ms=ctx->cfg.tick_ms/c->rate, rtt_ms=tcp_rtt_us(c->fd)/1000.0;
+    if (q > RATE_FRAME_MAX*(1.0+rtt_ms/period_ms)){
+        if (c->rate>lo) atomic_fetch_add(&ctx->rate_backoffs,1);
+        c->rate/=2; if (c->rate<lo) c->rate=lo;
+    } else if (drained>=wrote){
+        c->rate+=(hi-lo)/RATE_STEPS; if (c->rate>hi) c->rate=hi;
+    }
+}
+
+// Whether c gets this tick's frame; tells the peer when its period moved. A
+// skipped tick makes the next frame a full one, since a delta would be
+// relative to a frame the peer never saw.
+static bool rate_due(avt_ctx_t *ctx, avt_sess_t *c){
+    c->credit+=c->rate;
+    if (c->credit<1){ c->need_full=true; return false; }
+    c->credit-=1;
+    rate_adapt(ctx,c);
+    int ms=(int)(ctx->cfg.tick_ms/c->rate+0.5), told=c->told_ms;
+    bool bound=c->rate<=1.0/ctx->cfg.period_max || c->rate>=1.0/ctx->cfg.period_min;
+    if (ms!=told && (bound || abs(ms-told) > told*RATE_NOTIFY)
+        && (ctx->bc_ticks-c->told_tick)*ctx->cfg.tick_ms >= RATE_NOTIFY_MS){
+        sess_printf(c,"RATE period_ms=%d\n", ms); c->told_ms=ms; c->told_tick=ctx->bc_ticks;
+    }
+    return true;
+}
+
+// Each encoding is produced at most once per tick, and only if some client uses it;
+// derived metrics are computed once, then encoded once per distinct subscription.
+void avt_broadcast(avt_ctx_t *ctx, time_t now){
+    char text[TLM_LINE_MAX], bin[TLM_BIN_MAX], delta[TLM_BIN_MAX], drv[DRV_ALL+1][DRV_LINE_MAX];
+    size_t text_len=0, bin_len=0, delta_len=0, drv_len[DRV_ALL+1]={0};
+    tlm_sample_t cur; long dv[DRV_N];
+    avt_sample(ctx, &cur, now);
+    pthread_mutex_lock(&ctx->bc_mx);
+    derive(ctx, &cur, dv);
+    pthread_mutex_lock(&ctx->clients_mx);
+    for(avt_sess_t *c=ctx->clients; c; c=c->next){
+        if (ctx->cfg.period_max && !rate_due(ctx,c)) continue;
+        if (c->ready && tlm_conflate(c, &cur, dv)) continue;
+        if (c->fmt==TLM_FMT_TEXT){
+            if (!text_len) text_len=tlm_encode_text(&ctx->clk, text, &cur);
+            sess_write(c, text, text_len);
+        } else if (c->fmt==TLM_FMT_BIN || c->need_full || !ctx->have_prev){
+            if (!bin_len) bin_len=tlm_encode_bin(bin, &cur);
+            sess_write(c, bin, bin_len);
+            c->need_full=false;
+        } else {
+            if (!delta_len) delta_len=tlm_encode_delta(delta, &ctx->prev, &cur);
+            sess_write(c, delta, delta_len);
+        }
+        if (c->drv_mask){
+            if (!drv_len[c->drv_mask]) drv_len[c->drv_mask]=drv_encode(drv[c->drv_mask], dv, c->drv_mask);
+            sess_write(c, drv[c->drv_mask], drv_len[c->drv_mask]);
+        }
+    }
+    pthread_mutex_unlock(&ctx->clients_mx);
+    ctx->prev=cur; ctx->have_prev=true; ctx->bc_ticks++;
+    pthread_mutex_unlock(&ctx->bc_mx);
+    if (ctx->hist && !atomic_load(&ctx->hist_ingest)) avt_mem_charge(ctx, AVT_MEM_HISTORY, hist_add(ctx->hist, &cur));
+}
+
+// ---------- Sessions ----------
+avt_sess_t *avt_session_open(avt_ctx_t *ctx, const struct sockaddr_in *peer, int fd,
+                             avt_admit_t adm, avt_write_fn wr, void *user){
+    avt_sess_t *s=calloc(1,sizeof(*s));
+    if (!s){ avt_release(ctx, peer->sin_addr.s_addr, adm); return NULL; }
+    avt_mem_charge(ctx, AVT_MEM_SESSIONS, (long)sizeof(*s));
+    s->ctx=ctx; s->home=ctx; s->fd=fd; s->addr=*peer; s->wr=wr; s->wr_user=user; s->adm=adm;
+    s->role=ROLE_OBSERVER; s->since=wall_now(ctx); s->bad_step=-1; s->dd=-1; s->ros=-1;
+    pthread_mutex_init(&s->wmx,NULL);
+    char ip[64]; inet_ntop(AF_INET,&peer->sin_addr,ip,sizeof(ip));
+    snprintf(s->peer,sizeof(s->peer),"%s:%u", ip, ntohs(peer->sin_port));
+
+    pthread_mutex_lock(&ctx->clients_mx);
+    s->id=ctx->next_id++;
+    s->rate=1.0/ctx->cfg.period_min; s->credit=1; s->told_ms=ctx->cfg.period_min*ctx->cfg.tick_ms;
+    s->next=ctx->clients; ctx->clients=s;
+    pthread_mutex_unlock(&ctx->clients_mx);
+
+    ctx_log(ctx, s->peer, "connected");
+    if (ctx->rec) ctx->rec(ctx->rec_user, s->id, AVT_REC_OPEN, NULL, 0);
+    registry_touch(s);
+    sess_printf(s,"OK Welcome. Commands: HELLO|AUTH|ROLE?|LIST USERS|SPEED ...|TURN ...|QUIT\n");
+    if (ctx->cfg.period_max) sess_printf(s,"RATE period_ms=%d\n", s->told_ms);
+    return s;
+}
+
+int avt_session_admin(const avt_sess_t *s){ return s->role==ROLE_ADMIN; }
+
+void avt_session_set_ready(avt_sess_t *s, avt_ready_fn ready){
+    pthread_mutex_lock(&s->ctx->clients_mx); s->ready=ready; pthread_mutex_unlock(&s->ctx->clients_mx);
+}
+
+int avt_session_pending(avt_sess_t *s){
+    pthread_mutex_lock(&s->wmx); int held=s->held; pthread_mutex_unlock(&s->wmx);
+    return held;
+}
+
+void avt_session_flush(avt_sess_t *s){
+    pthread_mutex_lock(&s->wmx);
+    if (s->held) held_flush(s);
+    pthread_mutex_unlock(&s->wmx);
+}
+
+void avt_session_close(avt_sess_t *s){
+    avt_ctx_t *ctx=s->ctx;
+    if (ctx->rec) ctx->rec(ctx->rec_user, s->id, AVT_REC_CLOSE, NULL, 0);
+    roster_update(ctx,s,true);
+    pthread_mutex_lock(&ctx->clients_mx);
+    for(avt_sess_t **pp=&ctx->clients; *pp; pp=&(*pp)->next) if(*pp==s){ *pp=s->next; break; }
+    pthread_mutex_unlock(&ctx->clients_mx);
+    avt_release(s->home, s->addr.sin_addr.s_addr, s->adm);
+    avt_mem_charge(s->home, AVT_MEM_SESSIONS, -(long)sizeof(*s));
+    pthread_mutex_destroy(&s->wmx);
+    free(s);
+}
+
+// ---------- Rooms ----------
+// Room choice is only allowed before the session has state tied to its context
+// (the ADMIN role is not: credentials are the same in every room).
+static bool sess_fresh(const avt_sess_t *s){
+    return s->ctx==s->home && !s->in_batch && s->dd<0;
+}
+// Moves s from its lobby into room; the admission slot and memory charge stay with s->home.
+static void sess_move(avt_sess_t *s, avt_ctx_t *room){
+    avt_ctx_t *from=s->ctx;
+    roster_update(from,s,true);
+    pthread_mutex_lock(&from->clients_mx);
+    for(avt_sess_t **pp=&from->clients; *pp; pp=&(*pp)->next) if(*pp==s){ *pp=s->next; break; }
+    pthread_mutex_unlock(&from->clients_mx);
+    pthread_mutex_lock(&room->clients_mx);
+    s->ctx=room; s->need_full=true;   // a delta stream restarts in the new room
+    s->next=room->clients; room->clients=s;
+    pthread_mutex_unlock(&room->clients_mx);
+}
+
+// Executes one request line; returns 1 when the session must be closed.
+static int sess_line(avt_sess_t *s, char *p){
+    avt_ctx_t *ctx=s->ctx; const char *pid=s->peer;
+    if (ctx->rec) ctx->rec(ctx->rec_user, s->id, AVT_REC_LINE, p, strlen(p));
+    if(strncmp(p,"AUTH ",5)==0 && auth_blocked(ctx->acct,s->addr.sin_addr.s_addr)){
+        sess_printf(s,"ERR backoff\n"); return 0;
+    }
+    ctx_log(ctx, pid, "REQ: %s", p);
+
+    if(s->adm==AVT_ADMIT_RESERVED && s->role!=ROLE_ADMIN && strncmp(p,"HELLO",5)!=0 && strncmp(p,"AUTH ",5)!=0){
+        sess_printf(s,"ERR busy\n"); return 1;
+    }
+    char key[DEDUP_KEY_LEN], reply[128];
+    if(split_key(&p,key,sizeof(key))<0){
+        sess_printf(s,"ERR bad key\n");
+    } else if(key[0] && s->role!=ROLE_ADMIN){
+        sess_printf(s,"ERR forbidden\n");
+    } else if(s->in_batch && strcmp(p,"QUIT")!=0){
+        op_t op=parse_op(p);
+        if(key[0] && strcmp(p,"COMMIT")!=0){
+            // only COMMIT applies anything, so only its key can be honoured
+            sess_printf(s,"ERR bad key\n");
+            if(op!=OP_NONE && s->bad_step<0) s->bad_step=s->nops;
+        } else if(strcmp(p,"COMMIT")==0){
+            if(!dedup_begin(s,key,reply,sizeof(reply))){
+                if(s->bad_step>=0) snprintf(reply,sizeof(reply),"ERR batch step=%d invalid", s->bad_step+1);
+                else control_run(ctx, s->ops, s->nops, 1, reply, sizeof(reply));
+                dedup_end(s,key,reply);
+            }
+            sess_printf(s,"%s\n", reply); s->in_batch=false;
+        } else if(strcmp(p,"ABORT")==0){
+            sess_printf(s,"OK aborted\n"); s->in_batch=false;
+        } else if(op!=OP_NONE && s->nops<BATCH_MAX){
+            s->ops[s->nops++]=op;
+        } else if(s->bad_step<0){
+            s->bad_step=s->nops; // steps after an invalid one are ignored; COMMIT will fail
+        }
+    } else if(strcmp(p,"QUIT")==0){
+        sess_printf(s,"BYE\n"); ctx_log(ctx,pid,"BYE"); return 1;
+    } else if(strncmp(p,"HELLO",5)==0){
+        const char *r=p+5; while(*r==' ') r++;
+        if (strncmp(r,"room=",5)==0){
+            char name[AVT_ROOM_NAME]; int n=0;
+            if (sscanf(r+5,"%31[A-Za-z0-9_.-]%n",name,&n)!=1 || (r[5+n] && r[5+n]!=' ')){ sess_printf(s,"ERR bad room\n"); return 0; }
+            if (!sess_fresh(s)){ sess_printf(s,"ERR room must be chosen first\n"); return 0; }
+            avt_ctx_t *room=ctx->room ? ctx->room(ctx->room_user, name, s->role==ROLE_ADMIN) : NULL;
+            if (!room){ sess_printf(s,"ERR no room\n"); return 0; }
+            if (room!=ctx){ ctx_log(ctx,pid,"-> room %s",name); sess_move(s,room); ctx=room; ctx_log(ctx,pid,"joined"); }
+        }
+        const char *k=strstr(p,"name="); if(k){ k+=5; while(*k==' ') k++; strncpy(s->name,k,sizeof(s->name)-1); }
+        registry_touch(s);
+        sess_printf(s,"OK hello %s\n", s->name[0]?s->name:"observer");
+    } else if(strncmp(p,"AUTH ",5)==0){
+        char u[64]={0}, pw[64]={0};
+        if(sscanf(p+5,"%63s %63s",u,pw)==2 && strcmp(u,"admin")==0 && strcmp(pw,"admin123")==0){
+            auth_record(ctx->acct,s->addr.sin_addr.s_addr,1);
+            s->role=ROLE_ADMIN; registry_touch(s); sess_printf(s,"OK admin\n");
+        } else {
+            if(s->adm==AVT_ADMIT_RESERVED){ auth_record(ctx->acct,s->addr.sin_addr.s_addr,0); sess_printf(s,"ERR busy\n"); return 1; }
+            if(auth_record(ctx->acct,s->addr.sin_addr.s_addr,0)) ctx_log(ctx,pid,"AUTH backoff %ds", AUTH_BACKOFF_S);
+            sess_printf(s,"ERR invalid credentials\n");
+        }
+    } else if(strcmp(p,"ROLE?")==0){
+        sess_printf(s,"OK %s\n", s->role==ROLE_ADMIN?"ADMIN":"OBSERVER");
+    } else if(strcmp(p,"LIST USERS")==0 || strncmp(p,"LIST USERS ",11)==0){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");
+        else list_users_to(s, p+10);
+    } else if(strncmp(p,"HISTORY",7)==0 && (p[7]==' ' || !p[7])){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");   // a raw range can read the whole spill file
+        else history_to(s, p+7);
+    } else if(strcmp(p,"STATS")==0){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");
+        else stats_to(s);
+    } else if(parse_op(p)!=OP_NONE){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");
+        else {
+            if(!dedup_begin(s,key,reply,sizeof(reply))){
+                op_t op=parse_op(p);
+                control_run(ctx, &op, 1, 0, reply, sizeof(reply));
+                dedup_end(s,key,reply);
+            }
+            sess_printf(s,"%s\n", reply);
+        }
+    } else if(strncmp(p,"FORMAT ",7)==0){
+        const char *f=p+7; int fmt=-1;
+        if(strcasecmp(f,"TEXT")==0) fmt=TLM_FMT_TEXT;
+        else if(strcasecmp(f,"BIN")==0) fmt=TLM_FMT_BIN;
+        else if(strcasecmp(f,"DELTA")==0) fmt=TLM_FMT_DELTA;
+        if(fmt<0) sess_printf(s,"ERR bad format\n");
+        else {
+            pthread_mutex_lock(&ctx->clients_mx);
+            s->fmt=(tlm_fmt_t)fmt; s->need_full=true;   // a delta stream starts from a full frame
+            pthread_mutex_unlock(&ctx->clients_mx);
+            sess_printf(s,"OK format=%s\n", fmt==TLM_FMT_TEXT?"TEXT":fmt==TLM_FMT_BIN?"BIN":"DELTA");
+        }
+    } else if(strncmp(p,"DERIVED ",8)==0){
+        int mask=drv_parse(p+8);
+        if(mask<0) sess_printf(s,"ERR bad metric\n");
+        else {
+            pthread_mutex_lock(&ctx->clients_mx);
+            s->drv_mask=(unsigned)mask;
+            pthread_mutex_unlock(&ctx->clients_mx);
+            char list[64]=""; size_t n=0;
+            for(int i=0;i<DRV_N;i++) if(mask>>i&1) n+=(size_t)snprintf(list+n,sizeof(list)-n,"%s%s",n?",":"",k_drv_name[i]);
+            sess_printf(s,"OK derived=%s\n", mask?list:"none");
+        }
+    } else if(strcmp(p,"SESSION")==0 || strncmp(p,"SESSION ",8)==0){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");
+        else { session_cmd(s, p[7]?p+8:"", reply, sizeof(reply)); sess_printf(s,"%s\n", reply); }
+    } else if(strcmp(p,"BEGIN")==0){
+        if(s->role!=ROLE_ADMIN) sess_printf(s,"ERR forbidden\n");
+        else { s->in_batch=true; s->nops=0; s->bad_step=-1; sess_printf(s,"OK begin\n"); }
+    } else if(strcmp(p,"COMMIT")==0 || strcmp(p,"ABORT")==0){
+        // a retried "@key COMMIT" whose batch already committed gets its original reply
+        if(!dedup_begin(s,key,reply,sizeof(reply))){ dedup_cancel(s,key); snprintf(reply,sizeof(reply),"ERR no batch"); }
+        sess_printf(s,"%s\n", reply);
+    } else {
+        sess_printf(s,"ERR unknown\n");
+    }
+    if(mono_now(ctx) - s->rtt_at >= ROSTER_RTT_S) registry_touch(s);
+    ctx_log(ctx, pid, "DONE");
+    return 0;
+}
+
+int avt_session_feed(avt_sess_t *s, const char *data, size_t len){
+    while(len){
+        const char *nl=memchr(data,'\n',len);
+        size_t chunk = nl ? (size_t)(nl-data) : len;
+        if (!s->overflow){
+            if (s->inlen + chunk < sizeof(s->in)){ memcpy(s->in+s->inlen, data, chunk); s->inlen+=chunk; }
+            else s->overflow=true;
+        }
+        if (!nl) break;
+        data+=chunk+1; len-=chunk+1;
+        if (s->overflow){ s->overflow=false; s->inlen=0; sess_printf(s,"ERR line too long\n"); continue; }
+        size_t L=s->inlen; s->inlen=0;
+        if (L && s->in[L-1]=='\r') L--;
+        s->in[L]='\0';
+        if (sess_line(s, s->in)) return 1;
+    }
+    return 0;
+}
+
+// ---------- Context ----------
+void avt_config_default(avt_config_t *cfg){
+    cfg->max_conn=256; cfg->max_per_ip=16; cfg->admin_reserve=4;
+    cfg->tick_ms=10000; cfg->period_min=1; cfg->period_max=0;
+    cfg->mem_budget=0; cfg->conn_mem=0;
+    cfg->hist_mem=0; cfg->hist_spill=NULL;
+}
+
+avt_ctx_t *avt_create(const avt_config_t *cfg){
+    avt_ctx_t *ctx=calloc(1,sizeof(*ctx));
+    if (!ctx) return NULL;
+    if (cfg) ctx->cfg=*cfg; else avt_config_default(&ctx->cfg);
+    if (ctx->cfg.tick_ms<1) ctx->cfg.tick_ms=1;
+    if (ctx->cfg.period_min<1) ctx->cfg.period_min=1;
+    if (ctx->cfg.period_max && ctx->cfg.period_max<ctx->cfg.period_min) ctx->cfg.period_max=ctx->cfg.period_min;
+    ctx->veh=(vehicle_t){ .speed=0, .battery=100, .temp=35, .dir=DIR_N };
+    ctx->next_id=1;
+    ctx->acct=ctx; avt_mem_charge(ctx, AVT_MEM_CTX, (long)sizeof(*ctx));
+    pthread_mutex_init(&ctx->state_mx,NULL);
+    pthread_mutex_init(&ctx->clients_mx,NULL);
+    pthread_mutex_init(&ctx->roster_mx,NULL);
+    for(int i=0;i<AUTH_STRIPES;i++) pthread_mutex_init(&ctx->auth_mx[i],NULL);
+    pthread_mutex_init(&ctx->dedup_mx,NULL);
+    pthread_mutex_init(&ctx->admit_mx,NULL);
+    pthread_mutex_init(&ctx->bc_mx,NULL);
+    pthread_mutex_init(&ctx->tick_mx,NULL);
+    if (ctx->cfg.hist_mem>0){
+        if (!(ctx->hist=hist_create((size_t)ctx->cfg.hist_mem, ctx->cfg.hist_spill))){ int e=errno; avt_destroy(ctx); errno=e; return NULL; }
+        avt_mem_charge(ctx, AVT_MEM_HISTORY, (long)hist_mem(ctx->hist));
+    }
+    return ctx;
+}
+
+void avt_set_logger(avt_ctx_t *ctx, avt_log_fn fn, void *user){ ctx->log=fn; ctx->log_user=user; }
+
+void avt_set_recorder(avt_ctx_t *ctx, avt_record_fn fn, void *user){ ctx->rec=fn; ctx->rec_user=user; }
+
+void avt_set_clock(avt_ctx_t *ctx, avt_clock_fn fn, void *user, uint64_t seed){
+    ctx->clock=fn; ctx->clock_user=user; ctx->seed=seed?seed:0x9E3779B97F4A7C15ull;
+}
+
+void avt_set_rooms(avt_ctx_t *ctx, avt_room_fn fn, void *user){ ctx->room=fn; ctx->room_user=user; }
+
+void avt_set_control(avt_ctx_t *ctx, avt_control_fn fn, void *user){ ctx->control=fn; ctx->control_user=user; }
+
+avt_ctx_t *avt_room_create(avt_ctx_t *lobby){
+    if (!mem_fits(lobby, (long)sizeof(avt_ctx_t))) return NULL;
+    avt_config_t cfg=lobby->cfg; cfg.hist_mem=0;
+    avt_ctx_t *room=avt_create(&cfg);
+    if (!room) return NULL;
+    atomic_store(&room->mem[AVT_MEM_CTX], 0);
+    room->acct=lobby->acct; avt_mem_charge(room, AVT_MEM_CTX, (long)sizeof(*room));
+    return room;
+}
+
+void avt_destroy(avt_ctx_t *ctx){
+    if (!ctx) return;
+    for(avt_sess_t *c=ctx->clients;c;){
+        avt_sess_t *n=c->next; pthread_mutex_destroy(&c->wmx); free(c); c=n;
+    }
+    avt_mem_charge(ctx, AVT_MEM_ROSTER, -(long)((size_t)ctx->roster_cap*sizeof(roster_entry_t)));
+    free(ctx->roster);
+    free(ctx->dedup); hist_destroy(ctx->hist);
+    pthread_mutex_destroy(&ctx->state_mx);
+    pthread_mutex_destroy(&ctx->clients_mx);
+    pthread_mutex_destroy(&ctx->roster_mx);
+    for(int i=0;i<AUTH_STRIPES;i++) pthread_mutex_destroy(&ctx->auth_mx[i]);
+    pthread_mutex_destroy(&ctx->dedup_mx);
+    pthread_mutex_destroy(&ctx->admit_mx);
+    pthread_mutex_destroy(&ctx->bc_mx);
+    pthread_mutex_destroy(&ctx->tick_mx);
+    free(ctx);
+}
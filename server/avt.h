@@ -0,0 +1,173 @@
+// Autonomous Vehicle Project - libavt: embeddable telemetry core
+//
+// The vehicle model, the AVT protocol, the client registry and the TLM
+// encoders behind an explicit context object (avt_ctx_t), so a process can run
+// any number of independent instances. server.c is a thin socket/thread front
+// end over this library; simulators, test harnesses and benchmarks can create
+// contexts and drive sessions in-process without sockets.
+//
+// Typical use:
+//   avt_ctx_t *ctx = avt_create(NULL);
+//   avt_sess_t *s = avt_session_open(ctx, &peer, -1, AVT_ADMIT_NONE, my_write, my_user);
+//   avt_session_feed(s, "AUTH admin admin123\nSPEED UP\n", 29);   // replies go to my_write
+//   avt_step(ctx); avt_broadcast(ctx, time(NULL));                 // one telemetry tick
+//   avt_session_close(s); avt_destroy(ctx);
+//
+// Threading: every function is thread-safe, except that one session must only
+// be fed by one thread at a time, and a context must outlive its sessions.
+
+#ifndef AVT_H
+#define AVT_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tlm.h"
+
+typedef struct avt_ctx  avt_ctx_t;
+typedef struct avt_sess avt_sess_t;
+
+typedef struct {
+    int max_conn;       // connections admitted from the general pool
+    int max_per_ip;     // connections per source IPv4 (both pools)
+    int admin_reserve;  // extra slots usable only by connections that AUTH as admin
+    // Adaptive telemetry rate: each session gets a frame every period_min..period_max
+    // ticks, adjusted AIMD-style from its send queue and RTT, and is told the
+    // effective rate (RATE period_ms=). period_max 0 = every tick to everyone.
+    int tick_ms;        // driver tick period, used to report rates
+    int period_min, period_max;
+    // Memory: admission and optional allocations are refused (STATS mem_shed)
+    // once the accounted total would exceed mem_budget bytes (0 = no limit).
+    long mem_budget;
+    long conn_mem;      // bytes the front end spends per connection (stack, buffers)
+    // History (HISTORY): every broadcast sample is kept in memory up to hist_mem
+    // bytes (0 = off), raw samples evicted first, then per-minute rollups; with
+    // hist_spill evicted raw blocks go to that file instead (see hist.h). Rooms keep none.
+    long hist_mem;
+    const char *hist_spill;
+} avt_config_t;
+
+// Memory accounting subsystems; STATS reports each as mem_<name>.
+typedef enum {
+    AVT_MEM_CTX=0,       // the context itself (admission and AUTH tables)
+    AVT_MEM_SESSIONS,    // session state, including the input line buffer
+    AVT_MEM_CONN,        // front-end share per admitted connection (cfg.conn_mem)
+    AVT_MEM_ROSTER,      // LIST USERS snapshots, including ones still being read
+    AVT_MEM_DEDUP,       // idempotency-key records
+    AVT_MEM_CAPTURE,     // charged by the front end, e.g. the --record writer
+    AVT_MEM_HISTORY,     // telemetry history tiers and spill index (cfg.hist_mem caps it)
+    AVT_MEM_INGEST,      // avt_ingest_udp() receive buffers
+    AVT_MEM_N
+} avt_mem_t;
+
+// Outcome of avt_admit(); AVT_ADMIT_NONE opens a session outside admission control.
+typedef enum { AVT_ADMIT_REFUSED=0, AVT_ADMIT_GENERAL, AVT_ADMIT_RESERVED, AVT_ADMIT_NONE } avt_admit_t;
+
+// Delivers bytes (replies and telemetry) to a session's peer; returns <0 on failure.
+typedef int  (*avt_write_fn)(void *user, const char *buf, size_t len);
+// Receives one formatted log message; peer is "ip:port" or NULL.
+typedef void (*avt_log_fn)(void *user, const char *peer, const char *msg);
+// Sees every session open, inbound request line (without '\n') and close, in order per session.
+enum { AVT_REC_OPEN=0, AVT_REC_LINE=1, AVT_REC_CLOSE=2 };
+typedef void (*avt_record_fn)(void *user, uint64_t sess_id, int event, const char *line, size_t len);
+// Whether a session's peer can take a telemetry frame right now (see avt_session_set_ready).
+typedef int  (*avt_ready_fn)(void *user);
+// Resolves HELLO room=<name> to the context to move the session into, or NULL.
+// create is set for ADMIN sessions only; otherwise only an existing room may be returned.
+#define AVT_ROOM_NAME 32   // max room name length + 1; names are [A-Za-z0-9_.-]
+typedef avt_ctx_t *(*avt_room_fn)(void *user, const char *name, int create);
+// Runs vehicle control elsewhere (see avt_set_control); writes the reply line without '\n'.
+typedef void (*avt_control_fn)(void *user, const char *steps, int batch, char *reply, size_t rsz);
+// Virtual clock (seconds) for deterministic runs.
+typedef time_t (*avt_clock_fn)(void *user);
+
+void        avt_config_default(avt_config_t *cfg);
+avt_ctx_t  *avt_create(const avt_config_t *cfg);          // NULL cfg: defaults; NULL (errno set) on failure
+void        avt_destroy(avt_ctx_t *ctx);                   // frees any sessions still open
+void        avt_set_logger(avt_ctx_t *ctx, avt_log_fn fn, void *user);   // default: silent
+void        avt_set_recorder(avt_ctx_t *ctx, avt_record_fn fn, void *user);   // e.g. rec_put (rec.h)
+// Deterministic mode: every internal timestamp (AUTH windows, dedup TTL, SINCE)
+// comes from fn and SESSION tokens from a PRNG seeded with seed. Set before
+// opening sessions. With fd=-1 sessions fed from one thread, replies and frames
+// are then a pure function of the input order and the clock (see avtsim.c).
+void        avt_set_clock(avt_ctx_t *ctx, avt_clock_fn fn, void *user, uint64_t seed);
+
+// Rooms: isolated contexts (own vehicle, clients, log stream) that a session
+// joins with HELLO room=<name> while still in the lobby. The session keeps its
+// admission slot in the context that admitted it (the lobby), and a room's
+// memory and AUTH failures are charged to the lobby, so its budget and backoff
+// cover every room. The driver steps and broadcasts each room itself.
+void        avt_set_rooms(avt_ctx_t *lobby, avt_room_fn fn, void *user);
+avt_ctx_t  *avt_room_create(avt_ctx_t *lobby);   // lobby's config; NULL: out of memory or budget
+
+// Remote vehicle: SPEED/TURN commands and committed batches are handed to fn
+// instead of changing this context's vehicle, whose state then comes from
+// avt_ingest(). steps has one letter per step: U(p), D(own), L(eft), R(ight);
+// batch=0 is a single command. The server's --workers mode forwards them to
+// the simulation process, which runs them with avt_control().
+void        avt_set_control(avt_ctx_t *ctx, avt_control_fn fn, void *user);
+// Applies steps to ctx's own vehicle, replying as a local session would; -1 on malformed steps.
+int         avt_control(avt_ctx_t *ctx, const char *steps, int batch, char *reply, size_t rsz);
+
+// Adds (bytes > 0) or removes memory held on the context's behalf to its accounting.
+void        avt_mem_charge(avt_ctx_t *ctx, avt_mem_t kind, long bytes);
+// Charges bytes only if they stay within cfg.mem_budget; 0 (counted as mem_shed) if not.
+int         avt_mem_reserve(avt_ctx_t *ctx, avt_mem_t kind, long bytes);
+long        avt_mem_used(avt_ctx_t *ctx);
+
+// Admission: O(1) decision for a new connection from ip (network byte order);
+// refused too when the connection's memory would exceed cfg.mem_budget.
+// A non-refused result must be handed to avt_session_open(), which owns the slot from then on.
+avt_admit_t avt_admit(avt_ctx_t *ctx, uint32_t ip);
+// Gives back a slot that never reached avt_session_open() (no-op for REFUSED/NONE).
+void        avt_release(avt_ctx_t *ctx, uint32_t ip, avt_admit_t adm);
+
+// Opens a session and sends the welcome line. fd is only used to sample TCP RTT
+// (pass -1 for in-process sessions). Returns NULL (slot released) on allocation failure.
+avt_sess_t *avt_session_open(avt_ctx_t *ctx, const struct sockaddr_in *peer, int fd,
+                             avt_admit_t adm, avt_write_fn wr, void *user);
+// Feeds raw bytes from the peer; complete lines are executed in order and
+// partial lines are kept for the next call. Returns 1 when the session must be closed.
+int         avt_session_feed(avt_sess_t *s, const char *data, size_t len);
+void        avt_session_close(avt_sess_t *s);
+int         avt_session_admin(const avt_sess_t *s);   // authenticated as admin
+// Telemetry conflation: each tick asks ready(user) (same user as the write fn)
+// before writing a frame. When the peer is not ready the sample is held in the
+// session, replacing any older held one (STATS tlm_conflated), and goes out as
+// a full frame on avt_session_flush() or at the next tick the peer is ready.
+// Replies are never held. Keeps stale frames out of kernel buffers when used
+// with TCP_NOTSENT_LOWAT (see server.c --notsent-lowat).
+void        avt_session_set_ready(avt_sess_t *s, avt_ready_fn ready);
+int         avt_session_pending(avt_sess_t *s);        // 1 while a sample is held
+void        avt_session_flush(avt_sess_t *s);          // writes the held sample, if any
+
+// Simulation: one model step, then one telemetry frame to every session.
+void        avt_step(avt_ctx_t *ctx);
+void        avt_broadcast(avt_ctx_t *ctx, time_t now);
+// Driver report for one tick: how late it woke (us) and whether it missed its
+// period; STATS shows the count, p99 and max lateness and the overruns.
+void        avt_tick_note(avt_ctx_t *ctx, long late_us, int overrun);
+// Current vehicle state as a TLM sample stamped with now.
+void        avt_sample(avt_ctx_t *ctx, tlm_sample_t *out, time_t now);
+
+// External ingestion (replaces avt_step when a real vehicle feeds the context):
+// applies n samples in order. Every valid one goes to the history (cfg.hist_mem),
+// which from then on is fed by ingestion instead of avt_broadcast(); the last one
+// becomes the vehicle state the next avt_broadcast() fans out. Samples with an
+// unknown dir are counted and dropped.
+void        avt_ingest(avt_ctx_t *ctx, const tlm_sample_t *s, size_t n);
+// Receive buffers for avt_ingest_udp(), owned by the thread that calls it
+// (about 100 KiB, charged to AVT_MEM_INGEST). NULL (errno set) on failure.
+typedef struct avt_ingest_buf avt_ingest_buf_t;
+avt_ingest_buf_t *avt_ingest_buf_new(avt_ctx_t *ctx);
+void        avt_ingest_buf_free(avt_ctx_t *ctx, avt_ingest_buf_t *b);
+// Receives one recvmmsg() batch from a bound UDP socket into b (waits for the
+// first datagram, honouring SO_RCVTIMEO), decodes every binary frame in it and
+// calls avt_ingest(). With from != INADDR_ANY (IPv4, network byte order), datagrams
+// from any other address are counted as ingest_bad and dropped. Returns the
+// number of samples applied, or -1 on a socket error.
+int         avt_ingest_udp(avt_ctx_t *ctx, int fd, uint32_t from, avt_ingest_buf_t *b);
+
+#endif
@@ -0,0 +1,166 @@
+// Autonomous Vehicle Project - deterministic simulation runner
+// Build: make avtsim
+// Run:   ./avtsim [--seed N] [--start EPOCH] [--tick S] [--check GOLDEN] <script>
+//
+// Drives one libavt context from a command script on a virtual clock, single
+// threaded, and prints every byte the sessions receive. The output depends only
+// on the script and the options, so it can be saved once and compared after a
+// change to the model, the protocol or the encoders (--check GOLDEN exits 1 at
+// the first differing line). Runs as fast as the core allows.
+//
+// Script (one command per line, '#' comments):
+//   history <bytes>          keep HISTORY samples (cfg.hist_mem); before any other command
+//   <sess> <protocol line>   feed a line to session <sess> (opened on first use)
+//   tick [n]                 n telemetry ticks: advance the clock by --tick, step, broadcast
+//   advance <s>              advance the clock without a tick
+//   close <sess>             close the session
+//
+// Output: "<sess> <text line>" for replies and text frames; binary frames as
+// "<sess> bin <hex bytes>". Timestamps are formatted in UTC.
+//
+// Golden outputs live next to the scripts (scenarios/<name>.out); `make check`
+// compares every scenario against its own. After an intended output change,
+// regenerate with ./avtsim scenarios/<name>.avt > scenarios/<name>.out and
+// review the diff.
+
+#define _GNU_SOURCE
+#include "avt.h"
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_SESSIONS  64
+#define SIM_LINE      2048
+
+typedef struct { char name[32]; avt_sess_t *s; int open; } sim_sess_t;
+
+static time_t g_clock = 1700000000;
+static sim_sess_t g_sess[SIM_SESSIONS];
+static int g_nsess = 0;
+static FILE *g_golden = NULL;
+static long g_outline = 0;
+
+static time_t sim_clock(void *user){ (void)user; return g_clock; }
+
+// Emits one output line, or compares it with the next golden line.
+static void emit(const char *line){
+    g_outline++;
+    if (!g_golden){ fputs(line, stdout); fputc('\n', stdout); return; }
+    char want[4*SIM_LINE];
+    if (!fgets(want, sizeof(want), g_golden)){ fprintf(stderr,"line %ld: extra output: %s\n", g_outline, line); exit(1); }
+    want[strcspn(want,"\n")] = '\0';
+    if (strcmp(want, line)!=0){ fprintf(stderr,"line %ld differs\n  want: %s\n  got:  %s\n", g_outline, want, line); exit(1); }
+}
+
+static int sim_write(void *user, const char *buf, size_t len){
+    const sim_sess_t *ss = user; char line[4*SIM_LINE];
+    while (len){
+        int n = snprintf(line, sizeof(line), "%s ", ss->name);
+        size_t k;
+        if ((unsigned char)buf[0]==TLM_BIN_MAGIC && len>=3){
+            k = 3 + (unsigned char)buf[2]; if (k>len) k=len;
+            n += snprintf(line+n, sizeof(line)-(size_t)n, "bin");
+            for (size_t i=0; i<k; i++) n += snprintf(line+n, sizeof(line)-(size_t)n, " %02x", (unsigned char)buf[i]);
+        } else {
+            const char *nl = memchr(buf, '\n', len);
+            k = nl ? (size_t)(nl-buf)+1 : len;
+            size_t t = nl ? k-1 : k; if (t > sizeof(line)-(size_t)n-1) t = sizeof(line)-(size_t)n-1;
+            memcpy(line+n, buf, t); line[n+(int)t] = '\0';
+        }
+        emit(line);
+        buf += k; len -= k;
+    }
+    return 0;
+}
+
+static sim_sess_t *sess_get(avt_ctx_t *ctx, const char *name, int create){
+    for (int i=0; i<g_nsess; i++) if (g_sess[i].open && strcmp(g_sess[i].name,name)==0) return &g_sess[i];
+    if (!create || g_nsess==SIM_SESSIONS) return NULL;
+    sim_sess_t *ss = &g_sess[g_nsess];
+    snprintf(ss->name, sizeof(ss->name), "%s", name);
+    struct sockaddr_in peer = { .sin_family=AF_INET, .sin_port=htons((uint16_t)(40000+g_nsess)),
+                                .sin_addr.s_addr=htonl(0x0a000001u + (uint32_t)g_nsess) };
+    g_nsess++; ss->open = 1;
+    ss->s = avt_session_open(ctx, &peer, -1, AVT_ADMIT_NONE, sim_write, ss);
+    return ss->s ? ss : NULL;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,"Usage: %s [--seed N] [--start EPOCH] [--tick S] [--check GOLDEN] <script>\n", prog);
+}
+
+int main(int argc, char **argv){
+    static const struct option longopts[] = {
+        {"seed",  required_argument, NULL, 's'},
+        {"start", required_argument, NULL, 't'},
+        {"tick",  required_argument, NULL, 'k'},
+        {"check", required_argument, NULL, 'c'},
+        {NULL,0,NULL,0}
+    };
+    uint64_t seed = 1; long tick_s = 10; const char *golden = NULL; int opt;
+    while ((opt=getopt_long(argc,argv,"",longopts,NULL))!=-1){
+        switch(opt){
+        case 's': seed=strtoull(optarg,NULL,0); break;
+        case 't': g_clock=(time_t)atoll(optarg); break;
+        case 'k': tick_s=atol(optarg); break;
+        case 'c': golden=optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (argc-optind!=1 || tick_s<1){ usage(argv[0]); return 2; }
+    FILE *in = fopen(argv[optind], "r");
+    if (!in){ perror(argv[optind]); return 2; }
+    if (golden && !(g_golden=fopen(golden,"r"))){ perror(golden); return 2; }
+    setenv("TZ", "UTC", 1); tzset();
+
+    avt_config_t cfg; avt_config_default(&cfg);
+    avt_ctx_t *ctx = NULL;   // created at the first command that needs it, after 'history'
+
+    char line[SIM_LINE]; int ln = 0;
+    while (fgets(line, sizeof(line), in)){
+        ln++;
+        line[strcspn(line,"\r\n")] = '\0';
+        char *p = line; while (*p==' ' || *p=='\t') p++;
+        if (!*p || *p=='#') continue;
+        char word[32]; int n = 0;
+        sscanf(p, "%31s %n", word, &n);
+        char *arg = p+n;
+        if (strcmp(word,"history")==0){
+            if (ctx || (cfg.hist_mem=atol(arg))<=0){ fprintf(stderr,"%s:%d: history <bytes> must come first\n", argv[optind], ln); return 2; }
+            continue;
+        }
+        if (!ctx){
+            if (!(ctx=avt_create(&cfg))){ fprintf(stderr,"Out of memory\n"); return 2; }
+            avt_set_clock(ctx, sim_clock, NULL, seed);
+        }
+        if (strcmp(word,"tick")==0){
+            long k = *arg ? atol(arg) : 1;
+            for (long i=0; i<k; i++){ g_clock += tick_s; avt_step(ctx); avt_broadcast(ctx, g_clock); }
+        } else if (strcmp(word,"advance")==0){
+            g_clock += atol(arg);
+        } else if (strcmp(word,"close")==0){
+            sim_sess_t *ss = sess_get(ctx, arg, 0);
+            if (!ss){ fprintf(stderr,"%s:%d: no session '%s'\n", argv[optind], ln, arg); return 2; }
+            avt_session_close(ss->s); ss->open = 0;
+        } else {
+            sim_sess_t *ss = sess_get(ctx, word, 1);
+            if (!ss){ fprintf(stderr,"%s:%d: too many sessions\n", argv[optind], ln); return 2; }
+            size_t L = strlen(arg); arg[L] = '\n';
+            if (avt_session_feed(ss->s, arg, L+1)){ avt_session_close(ss->s); ss->open = 0; }
+        }
+    }
+    fclose(in);
+    for (int i=0; i<g_nsess; i++) if (g_sess[i].open) avt_session_close(g_sess[i].s);
+    if (ctx) avt_destroy(ctx);
+    if (g_golden){
+        char extra[8];
+        int short_out = fgets(extra, sizeof(extra), g_golden)!=NULL;
+        fclose(g_golden);
+        if (short_out){ fprintf(stderr,"output ended at line %ld, golden has more\n", g_outline); return 1; }
+        fprintf(stderr,"OK %ld lines match %s\n", g_outline, golden);
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Autonomous Vehicle Project - candump replay throughput benchmark
+// Build/run: make bench   (or ./bench_can [MB])
+//
+// Writes a synthetic `candump -l` capture (mix of mapped and unmapped ids,
+// standard and extended) to a temp file, then replays it with can_replay() in
+// fast mode and reports MB/s and frames/s. Run it on a file larger than RAM to
+// see disk-bound numbers; the default size measures the parser from page cache.
+
+#define _GNU_SOURCE
+#include "can.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_s(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+int main(int argc, char **argv){
+    long mb = argc>1 ? atol(argv[1]) : 256;
+    if (mb<1){ fprintf(stderr,"Usage: %s [MB]\n", argv[0]); return 1; }
+    char path[] = "/tmp/bench_can_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd>=0 ? fdopen(fd,"w") : NULL;
+    if (!f){ perror("mkstemp"); return 1; }
+
+    static const char *const ids[] = { "100", "200", "300", "7DF", "18FEF100" };
+    long written = 0, target = mb<<20; unsigned long x = 88172645463325252ul;
+    for (long i=0; written<target; i++){
+        x ^= x<<13; x ^= x>>7; x ^= x<<17;
+        int n = fprintf(f, "(%ld.%06ld) can0 %s#%016lX\n", 1700000000L+i/1000, (i%1000)*1000, ids[i%5], x);
+        if (n<0){ perror("write"); return 1; }
+        written += n;
+    }
+    fclose(f);
+
+    can_map_t map = { .n=4, .sig={
+        { 0x100, TLM_F_speed,   0, 16, 0.01, 0,   0 },
+        { 0x200, TLM_F_battery, 0, 8,  0.5,  0,   0 },
+        { 0x200, TLM_F_temp,    8, 8,  1,    -40, 0 },
+        { 0x300, TLM_F_dir,     0, 16, 0.01, 0,   0 } } };
+    avt_ctx_t *ctx = avt_create(NULL);
+    atomic_int stop = 0; can_stats_t st;
+    double s = now_s();
+    int rc = can_replay(ctx, path, &map, 0, &stop, &st);
+    double t = now_s() - s;
+    unlink(path);
+    if (rc<0){ perror("can_replay"); return 1; }
+
+    tlm_sample_t last; avt_sample(ctx, &last, 0);
+    printf("candump replay    : %.0f MB/s, %.1f M frames/s (%ld frames, %ld matched, %ld bad)\n",
+           (double)st.bytes/t/1048576.0, (double)st.frames/t/1e6, st.frames, st.matched, st.bad);
+    printf("last state        : speed=%d battery=%d temp=%d dir=%c\n", last.speed, last.battery, last.temp, last.dir);
+    avt_destroy(ctx);
+    return 0;
+}
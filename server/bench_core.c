@@ -0,0 +1,82 @@
+// Autonomous Vehicle Project - libavt in-process benchmark
+// Build/run: make bench
+//
+// Runs many independent contexts in one process, with no sockets: each gets a
+// few observer sessions and one admin session that is fed control commands,
+// then every context ticks and broadcasts. Replies and frames go to a counting
+// writer, so the numbers are the cost of the core itself.
+
+#define _GNU_SOURCE
+#include "avt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int count_write(void *user, const char *buf, size_t len){
+    (void)buf; *(size_t*)user += len; return 0;
+}
+
+static double now_s(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+int main(int argc, char **argv){
+    int nctx  = argc>1 ? atoi(argv[1]) : 200;
+    int nobs  = argc>2 ? atoi(argv[2]) : 8;
+    int ticks = argc>3 ? atoi(argv[3]) : 200;
+    if (nctx<1 || nobs<0 || ticks<1){ fprintf(stderr,"Usage: %s [contexts] [observers] [ticks]\n", argv[0]); return 1; }
+
+    avt_ctx_t **ctx = calloc((size_t)nctx, sizeof(*ctx));
+    avt_sess_t **adm = calloc((size_t)nctx, sizeof(*adm));
+    avt_sess_t **obs = calloc((size_t)nctx*(size_t)(nobs?nobs:1), sizeof(*obs));
+    if (!ctx || !adm || !obs){ fprintf(stderr,"Out of memory\n"); return 1; }
+    size_t bytes = 0;
+    struct sockaddr_in peer = { .sin_family=AF_INET, .sin_port=htons(40000) };
+
+    double s = now_s();
+    for (int i=0; i<nctx; i++){
+        if (!(ctx[i] = avt_create(NULL))){ fprintf(stderr,"avt_create failed\n"); return 1; }
+        peer.sin_addr.s_addr = htonl(0x0a000001u);
+        adm[i] = avt_session_open(ctx[i], &peer, -1, AVT_ADMIT_NONE, count_write, &bytes);
+        static const char login[] = "HELLO name=bench\nAUTH admin admin123\nFORMAT BIN\n";
+        avt_session_feed(adm[i], login, sizeof(login)-1);
+        for (int k=0; k<nobs; k++){
+            peer.sin_addr.s_addr = htonl(0x0a000100u + (uint32_t)k);
+            obs[(size_t)i*(size_t)nobs+(size_t)k] = avt_session_open(ctx[i], &peer, -1, AVT_ADMIT_NONE, count_write, &bytes);
+            if (k&1) avt_session_feed(obs[(size_t)i*(size_t)nobs+(size_t)k], "FORMAT DELTA\n", strlen("FORMAT DELTA\n"));
+        }
+    }
+    double t_setup = now_s() - s;
+
+    // Commands: a mix of single steps, a batch and a status query per round
+    static const char cmds[] =
+        "SPEED UP\nTURN LEFT\nSPEED UP\nROLE?\nBEGIN\nTURN RIGHT\nSLOW DOWN\nCOMMIT\nSLOW DOWN\nSTATS\n";
+    const int ncmds = 10, rounds = 50;
+    s = now_s();
+    for (int r=0; r<rounds; r++)
+        for (int i=0; i<nctx; i++) avt_session_feed(adm[i], cmds, sizeof(cmds)-1);
+    double t_cmd = now_s() - s;
+
+    time_t t0 = time(NULL);
+    s = now_s();
+    for (int t=0; t<ticks; t++)
+        for (int i=0; i<nctx; i++){ avt_step(ctx[i]); avt_broadcast(ctx[i], t0+t); }
+    double t_tick = now_s() - s;
+
+    for (int i=0; i<nctx; i++){
+        avt_session_close(adm[i]);
+        for (int k=0; k<nobs; k++) avt_session_close(obs[(size_t)i*(size_t)nobs+(size_t)k]);
+        avt_destroy(ctx[i]);
+    }
+    free(ctx); free(adm); free(obs);
+
+    long ncmd = (long)rounds*ncmds*nctx, nframes = (long)ticks*nctx*(nobs+1);
+    printf("contexts=%d sessions/ctx=%d (bytes out %zu)\n", nctx, nobs+1, bytes);
+    printf("setup             : %7.1f us/context\n", t_setup*1e6/nctx);
+    printf("commands          : %7.1f ns/command  (%ld)\n", t_cmd*1e9/(double)ncmd, ncmd);
+    printf("tick + broadcast  : %7.1f ns/frame    (%ld)\n", t_tick*1e9/(double)nframes, nframes);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Autonomous Vehicle Project - sustained UDP ingest benchmark
+// Build/run: make bench   (or ./bench_ingest [seconds] [frames/datagram])
+//
+// A synthetic producer thread pushes full binary TLM frames over loopback UDP
+// (sendmmsg, several frames per datagram) as fast as it can; the main thread
+// runs the server's ingest path, avt_ingest_udp(), on a libavt context.
+// Reports samples/s sent and ingested; the difference is kernel drops.
+// The decoder alone is timed first, without sockets.
+
+#define _GNU_SOURCE
+#include "avt.h"
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define PROD_BATCH  32    // datagrams per sendmmsg()
+
+static const char k_dirs[4] = { 'N','E','S','W' };
+static atomic_int g_done = 0;
+static atomic_long g_sent = 0;
+static int g_per_dgram = 16;
+static struct sockaddr_in g_dst;
+
+static double now_s(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+static size_t fill_dgram(char *out, long seq){
+    size_t len = 0;
+    for (int k=0; k<g_per_dgram; k++, seq++){
+        tlm_sample_t s = { .speed=(int)(seq%101), .battery=(int)(seq%97), .temp=35+(int)(seq%40),
+                           .dir=k_dirs[seq&3], .ts=(int64_t)(seq/1000) };
+        len += tlm_encode_bin(out+len, &s);
+    }
+    return len;
+}
+
+static void *producer(void *arg){
+    (void)arg;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd<0){ perror("socket"); return NULL; }
+    static char buf[PROD_BATCH][1472];
+    struct mmsghdr msg[PROD_BATCH]; struct iovec iov[PROD_BATCH];
+    long seq = 0;
+    while (!atomic_load(&g_done)){
+        for (int i=0; i<PROD_BATCH; i++){
+            iov[i] = (struct iovec){ .iov_base=buf[i], .iov_len=fill_dgram(buf[i], seq) };
+            msg[i] = (struct mmsghdr){ .msg_hdr={ .msg_name=&g_dst, .msg_namelen=sizeof(g_dst), .msg_iov=&iov[i], .msg_iovlen=1 } };
+            seq += g_per_dgram;
+        }
+        int n = sendmmsg(fd, msg, PROD_BATCH, 0);
+        if (n>0) atomic_fetch_add(&g_sent, (long)n*g_per_dgram);
+    }
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, char **argv){
+    double secs = argc>1 ? atof(argv[1]) : 3.0;
+    g_per_dgram = argc>2 ? atoi(argv[2]) : 16;
+    if (secs<=0 || g_per_dgram<1 || g_per_dgram*24>1472){
+        fprintf(stderr,"Usage: %s [seconds] [frames/datagram 1..61]\n", argv[0]); return 1;
+    }
+
+    // Decoder alone
+    char frame[TLM_BIN_MAX]; tlm_sample_t in = { 42, 77, 51, 'E', 1700000000 }, out; long sink = 0;
+    size_t flen = tlm_encode_bin(frame, &in);
+    long iters = 20000000;
+    double s = now_s();
+    for (long i=0; i<iters; i++){ frame[3] = (char)i; sink += tlm_decode_bin(frame, flen, &out) + out.speed; }
+    double t_dec = now_s() - s;
+
+    // Socket path
+    avt_ctx_t *ctx = avt_create(NULL);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 4<<20; setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = { .tv_usec=200000 }; setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    g_dst = (struct sockaddr_in){ .sin_family=AF_INET, .sin_addr.s_addr=htonl(INADDR_LOOPBACK) };
+    socklen_t al = sizeof(g_dst);
+    if (!ctx || fd<0 || bind(fd,(struct sockaddr*)&g_dst,sizeof(g_dst))<0 || getsockname(fd,(struct sockaddr*)&g_dst,&al)<0){
+        perror("setup"); return 1;
+    }
+
+    avt_ingest_buf_t *b = avt_ingest_buf_new(ctx);
+    if (!b){ perror("ingest"); return 1; }
+    pthread_t th; pthread_create(&th, NULL, producer, NULL);
+    long got = 0; s = now_s();
+    while (now_s()-s < secs){ int n = avt_ingest_udp(ctx, fd, htonl(INADDR_LOOPBACK), b); if (n<0){ perror("ingest"); break; } got += n; }
+    double t = now_s() - s;
+    atomic_store(&g_done, 1);
+    pthread_join(th, NULL);
+
+    tlm_sample_t last; avt_sample(ctx, &last, 0);
+    printf("tlm_decode_bin    : %7.1f ns/frame  (checksum %ld)\n", t_dec*1e9/(double)iters, sink);
+    printf("udp ingest        : %.2f M samples/s ingested, %.2f M/s sent (%d frames/datagram, %.1f%% dropped)\n",
+           (double)got/t/1e6, (double)atomic_load(&g_sent)/t/1e6, g_per_dgram,
+           atomic_load(&g_sent) ? 100.0*(1.0-(double)got/(double)atomic_load(&g_sent)) : 0.0);
+    printf("last state        : speed=%d battery=%d temp=%d dir=%c\n", last.speed, last.battery, last.temp, last.dir);
+    avt_ingest_buf_free(ctx, b); close(fd); avt_destroy(ctx);
+    return 0;
+}
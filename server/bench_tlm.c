@@ -0,0 +1,82 @@
+// Autonomous Vehicle Project - TLM encoder microbenchmark
+// Build/run: make bench
+//
+// Compares the original broadcast_tlm() formatting (localtime_r + strftime +
+// snprintf per frame) with tlm_encode_text(), after checking both produce the
+// same bytes over a sweep of field values and timestamps. The binary and delta
+// encoders are timed on the same input for reference.
+
+#define _GNU_SOURCE
+#include "tlm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char k_dirs[4] = { 'N','E','S','W' };
+
+static size_t encode_snprintf(char *line, size_t sz, int sp, int bt, int tp, char dir, time_t now){
+    struct tm tm; localtime_r(&now, &tm);
+    char ts[32]; strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+    char ds[2] = { dir, '\0' };
+    return (size_t)snprintf(line, sz, "TLM speed=%d;battery=%d;temp=%d;dir=%s;ts=%s\n", sp, bt, tp, ds, ts);
+}
+
+static double now_s(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+int main(int argc, char **argv){
+    long iters = argc>1 ? atol(argv[1]) : 5000000;
+    time_t t0 = time(NULL);
+
+    // Correctness: every value the vehicle model can produce plus a few extremes
+    tlm_clock_t clk = {0};
+    static const int extra[] = { -1, -10, -99, -100, 1000, 99999, 2147483647, -2147483647-1 };
+    for (int i=0; i<200000; i++){
+        int sp = i%101, bt = (i/7)%101, tp = 35+(i%46);
+        if (i<8){ sp = extra[i]; tp = extra[7-i]; }
+        time_t now = t0 + i/1000;
+        char a[TLM_LINE_MAX], b[TLM_LINE_MAX];
+        tlm_sample_t smp = { .speed=sp, .battery=bt, .temp=tp, .dir=k_dirs[i&3], .ts=now };
+        size_t la = encode_snprintf(a, sizeof(a), sp, bt, tp, k_dirs[i&3], now);
+        size_t lb = tlm_encode_text(&clk, b, &smp);
+        if (la!=lb || memcmp(a,b,la)!=0){
+            fprintf(stderr, "MISMATCH at %d:\n  %.*s  %.*s", i, (int)la, a, (int)lb, b);
+            return 1;
+        }
+    }
+
+    // Throughput: 1000 frames per simulated second, as at a 1 kHz tick
+    char line[TLM_LINE_MAX]; size_t sink = 0;
+    double s = now_s();
+    for (long i=0; i<iters; i++)
+        sink += encode_snprintf(line, sizeof(line), (int)(i%101), (int)(i%97), 35+(int)(i%40), k_dirs[i&3], t0 + i/1000);
+    double t_ref = now_s() - s;
+
+#define SAMPLE(i) (tlm_sample_t){ .speed=(int)((i)%101), .battery=(int)((i)%97), .temp=35+(int)((i)%40), \
+                                  .dir=k_dirs[(i)&3], .ts=t0 + (i)/1000 }
+    tlm_clock_t c2 = {0};
+    s = now_s();
+    for (long i=0; i<iters; i++){ tlm_sample_t smp = SAMPLE(i); sink += tlm_encode_text(&c2, line, &smp); }
+    double t_fast = now_s() - s;
+
+    char bin[TLM_BIN_MAX];
+    s = now_s();
+    for (long i=0; i<iters; i++){ tlm_sample_t smp = SAMPLE(i); sink += tlm_encode_bin(bin, &smp); __asm__ volatile("" : : "r"(bin) : "memory"); }   // keeps the frame live under -flto
+    double t_bin = now_s() - s;
+
+    tlm_sample_t prev = SAMPLE(0);
+    s = now_s();
+    for (long i=0; i<iters; i++){ tlm_sample_t smp = SAMPLE(i); sink += tlm_encode_delta(bin, &prev, &smp); prev = smp; }
+    double t_delta = now_s() - s;
+
+    printf("frames=%ld (text output identical)\n", iters);
+    printf("snprintf+strftime : %7.1f ns/frame\n", t_ref*1e9/(double)iters);
+    printf("tlm_encode_text   : %7.1f ns/frame  (%.1fx)\n", t_fast*1e9/(double)iters, t_ref/t_fast);
+    printf("tlm_encode_bin    : %7.1f ns/frame\n", t_bin*1e9/(double)iters);
+    printf("tlm_encode_delta  : %7.1f ns/frame  (checksum %zu)\n", t_delta*1e9/(double)iters, sink);
+    return 0;
+}
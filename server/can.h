@@ -0,0 +1,48 @@
+// Autonomous Vehicle Project - candump log replay (part of libavt)
+//
+// Replays a `candump -l` capture into a context as if a vehicle agent were
+// pushing samples (see avt_ingest()). Each line looks like
+//   (1700000000.123456) can0 1F3#0102030405060708
+// (extended 8-digit ids and CAN FD "##<flags><data>" lines are accepted; the
+// first 8 data bytes are used; remote/error frames are skipped).
+//
+// Signal map (text, one signal per line, '#' comments):
+//   <field> <can-id hex> <start bit> <bits> <scale> <offset> [le|be]
+//   speed    0x100  0   16  0.01  0    le
+//   battery  0x200  8   8   0.5   0
+//   temp     0x200  16  8   1     -40
+//   dir      0x300  0   16  0.01  0        # heading in degrees -> N/E/S/W
+// <field> is an INT or DIR field of tlm_schema.def; value = raw*scale+offset.
+// le: raw = bits [start, start+bits) of the payload read as a little-endian u64.
+// be: payload read as a big-endian u64, start counted from its most significant bit.
+
+#ifndef CAN_H
+#define CAN_H
+
+#include <stdatomic.h>
+
+#include "avt.h"
+
+#define CAN_MAP_MAX 16
+
+typedef struct {
+    uint32_t id; int field; int start, bits; double scale, offset; int be;
+} can_signal_t;
+
+typedef struct { int n; can_signal_t sig[CAN_MAP_MAX]; } can_map_t;
+
+typedef struct {
+    long   lines, frames, matched, bad;   // parsed lines / CAN frames / frames hitting the map / unparsable lines
+    size_t bytes;
+} can_stats_t;
+
+// Loads a signal map; returns 0, or -1 with a message in err.
+int can_map_load(const char *path, can_map_t *map, char *err, size_t esz);
+
+// Replays path (mmap'd) into ctx. realtime: sleep to reproduce the capture's
+// inter-frame timing; otherwise run as fast as possible. Stops early when
+// *stop becomes non-zero. Returns 0, or -1 (errno set) if the file can't be read.
+int can_replay(avt_ctx_t *ctx, const char *path, const can_map_t *map, int realtime,
+               atomic_int *stop, can_stats_t *st);
+
+#endif
@@ -0,0 +1,381 @@
+#!/usr/bin/env python3
+"""Generate the client-side TLM decoders from tlm_schema.def.
+
+Writes:
+  ../client/src/main/java/net/TlmCodec.java
+  ../admin/tlm_schema.py
+
+The server side needs no generation step: tlm.h/tlm.c expand the same
+schema file with X-macros. Run via `make schema` after editing the schema.
+"""
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCHEMA = os.path.join(HERE, "tlm_schema.def")
+JAVA_OUT = os.path.join(HERE, "..", "client", "src", "main", "java", "net", "TlmCodec.java")
+PY_OUT = os.path.join(HERE, "..", "admin", "tlm_schema.py")
+
+KINDS = {"INT": 4, "DIR": 1, "TIME": 8}   # binary width in bytes
+
+
+def load_schema(path):
+    fields = []
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"\s*TLM_FIELD\(\s*(\w+)\s*,\s*(\w+)\s*\)", line)
+            if m:
+                name, kind = m.groups()
+                if kind not in KINDS:
+                    sys.exit(f"{path}: unknown kind {kind} for field {name}")
+                fields.append((name, kind))
+    if not fields or len(fields) > 8:
+        sys.exit(f"{path}: expected 1..8 fields, found {len(fields)}")
+    return fields
+
+
+def label(i, name):
+    return ("TLM " if i == 0 else ";") + name + "="
+
+
+# ---------- Java ----------
+JAVA_TYPES = {"INT": "int", "DIR": "char"}
+JAVA_INIT = {"INT": "0", "DIR": "'N'"}
+
+# Text decoder sources: (parameter list, character at index {}, javadoc for the source)
+JAVA_SOURCES = [
+    ("CharSequence s", "s.charAt({})", "Characters holding the line"),
+    ("byte[] s", "(char) (s[{}] & 0xFF)", "Raw socket bytes holding the line (ASCII)"),
+]
+
+
+def gen_java_text(w, fields, param, ch, doc):
+    c = ch.format
+    w("    /**")
+    w("     * Decodes the text TLM line in {@code s[from, to)} into {@code f} without")
+    w("     * allocating. Fields must come in schema order; trailing whitespace is ignored.")
+    w("     *")
+    w(f"     * @param s {doc}")
+    w("     * @param from Start offset")
+    w("     * @param to End offset (exclusive)")
+    w("     * @param f Frame to fill")
+    w("     * @return true if the line matched the schema; {@code f} may be partially updated otherwise")
+    w("     */")
+    w(f"    public static boolean decodeText({param}, int from, int to, Frame f){{")
+    w("        int p = from, e, n = to;")
+    if any(k == "INT" for _, k in fields):
+        w("        long v;")
+    w(f"        while (n > p && {c('n-1')} <= ' ') n--;")
+    for i, (name, kind) in enumerate(fields):
+        lab = label(i, name)
+        last = i == len(fields) - 1
+        w(f'        if (!at(s, p, n, "{lab}")) return false;')
+        w(f"        p += {len(lab)};")
+        if kind == "INT":
+            w("        e = intEnd(s, p, n);")
+            w("        if (e == p) return false;")
+            w("        v = intValue(s, p, e);")
+            w("        if (v == Long.MIN_VALUE) return false;")
+            w(f"        f.{name} = (int) v;")
+            w("        p = e;")
+        elif kind == "DIR":
+            w("        if (p >= n) return false;")
+            w(f"        f.{name} = {c('p++')};")
+        else:
+            if last:
+                w("        e = n;")
+            else:
+                w("        for (e = p; e < n && " + c("e") + " != ';'; e++) ;")
+                w("        if (e == n) return false;")
+            w(f"        if (e - p > f.{name}Text.length) return false;")
+            w(f"        for (int i = p; i < e; i++) f.{name}Text[i - p] = {c('i')};")
+            w(f"        f.{name}Len = e - p; f.{name}Epoch = Long.MIN_VALUE;")
+            w("        p = e;")
+    w("        return p == n;")
+    w("    }")
+    w("")
+
+
+def gen_java_helpers(w, param, ch):
+    c = ch.format
+    w(f"    private static boolean at({param}, int p, int n, String lab){{")
+    w("        if (n - p < lab.length()) return false;")
+    w(f"        for (int i = 0; i < lab.length(); i++) if ({c('p + i')} != lab.charAt(i)) return false;")
+    w("        return true;")
+    w("    }")
+    w("")
+    w("    /** End of the integer at {@code p}: an optional '-' and at least one digit; {@code p} if none. */")
+    w(f"    private static int intEnd({param}, int p, int n){{")
+    w(f"        int d = p < n && {c('p')} == '-' ? p + 1 : p, e = d;")
+    w(f"        while (e < n && {c('e')} >= '0' && {c('e')} <= '9') e++;")
+    w("        return e == d ? p : e;")
+    w("    }")
+    w("")
+    w("    /** Value of the integer in {@code s[p, e)}, or {@link Long#MIN_VALUE} if it does not fit an int. */")
+    w(f"    private static long intValue({param}, int p, int e){{")
+    w(f"        boolean neg = {c('p')} == '-';")
+    w("        long v = 0;")
+    w("        for (int i = neg ? p + 1 : p; i < e; i++){")
+    w(f"            v = v * 10 + ({c('i')} - '0');")
+    w("            if (v > 0x80000000L) return Long.MIN_VALUE;")
+    w("        }")
+    w("        if (neg) v = -v;")
+    w("        return v >= Integer.MIN_VALUE && v <= Integer.MAX_VALUE ? v : Long.MIN_VALUE;")
+    w("    }")
+    w("")
+
+
+def gen_java(fields):
+    o = []
+    w = o.append
+    times = [n for n, k in fields if k == "TIME"]
+    w("// GENERATED by server/gen_schema.py from server/tlm_schema.def - do not edit.")
+    w("package net;")
+    w("")
+    w("import java.time.Instant;")
+    w("import java.time.ZoneId;")
+    w("import java.time.format.DateTimeFormatter;")
+    w("")
+    w("/**")
+    w(" * Telemetry frame codec generated from the server's TLM schema.")
+    w(" *")
+    w(" * <p>Each decoder is specialized for the exact field order of the schema:")
+    w(" * it checks the expected labels in place and converts values without")
+    w(" * splitting the line or looking fields up by name. Decoders write into a")
+    w(" * caller-owned {@link Frame} and allocate nothing: timestamps are kept as the")
+    w(" * received characters or epoch seconds and only become a String on request.")
+    w(" *")
+    w(" * <p>Supported encodings:")
+    w(" * <ul>")
+    w(" *   <li>Text: <code>" + "".join(label(i, n) + "&lt;" + k.lower() + "&gt;" for i, (n, k) in enumerate(fields)) + "</code>,")
+    w(" *       from a {@link CharSequence} or straight from socket bytes</li>")
+    w(" *   <li>Binary full frame: <code>0xA7 'F' len fields...</code></li>")
+    w(" *   <li>Binary delta frame: <code>0xA7 'D' len mask changed-fields...</code></li>")
+    w(" * </ul>")
+    w(" *")
+    w(" * @author Autonomous Vehicle Team")
+    w(" * @version 1.0")
+    w(" * @since 2025")
+    w(" */")
+    w("public final class TlmCodec {")
+    w("    /** First byte of every binary frame. */")
+    w("    public static final int MAGIC = 0xA7;")
+    w("")
+    w("    /** Field names in wire order. */")
+    w("    public static final String[] FIELDS = { " + ", ".join(f'"{n}"' for n, _ in fields) + " };")
+    w("")
+    w("    /** Delta mask with every field set (a full frame). */")
+    w(f"    public static final int FULL_MASK = 0x{(1 << len(fields)) - 1:X};")
+    w("")
+    w("    /** Longest text timestamp kept, in characters. */")
+    w("    public static final int TIME_TEXT_MAX = 32;")
+    w("")
+    w("    /** Timestamp format used by the text encoding (server local time). */")
+    w('    private static final DateTimeFormatter TS_FMT =')
+    w('            DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm:ss").withZone(ZoneId.systemDefault());')
+    w("")
+    w("    private TlmCodec(){}")
+    w("")
+    w("    /**")
+    w("     * Mutable decoded frame; decoders overwrite its fields in place so one")
+    w("     * instance can be reused for every message.")
+    w("     */")
+    w("    public static final class Frame {")
+    for n, k in fields:
+        if k == "TIME":
+            w(f"        /** Field <code>{n}</code> (TIME) as text, valid for {{@link #{n}Len}} chars. */")
+            w(f"        final char[] {n}Text = new char[TIME_TEXT_MAX];")
+            w(f"        /** Length of {{@link #{n}Text}}, 0 if the last value came from a binary frame. */")
+            w(f"        int {n}Len = 0;")
+            w(f"        /** Field <code>{n}</code> (TIME) from a binary frame: epoch seconds, or {{@link Long#MIN_VALUE}}. */")
+            w(f"        long {n}Epoch = Long.MIN_VALUE;")
+        else:
+            w(f"        /** Field <code>{n}</code> ({k}). */")
+            w(f"        public {JAVA_TYPES[k]} {n} = {JAVA_INIT[k]};")
+    for n in times:
+        w("")
+        w("        /**")
+        w(f"         * Returns <code>{n}</code> as text. This allocates, so call it when the")
+        w("         * value is displayed rather than for every message.")
+        w("         *")
+        w('         * @return "yyyy-MM-dd HH:mm:ss" as sent, or "-" if none was received yet')
+        w("         */")
+        w(f"        public String {n}String(){{")
+        w(f"            if ({n}Len > 0) return new String({n}Text, 0, {n}Len);")
+        w(f"            if ({n}Epoch != Long.MIN_VALUE) return TS_FMT.format(Instant.ofEpochSecond({n}Epoch));")
+        w('            return "-";')
+        w("        }")
+        w("")
+        w("        /**")
+        w(f"         * Returns <code>{n}</code> as epoch seconds when it came from a binary frame.")
+        w("         *")
+        w("         * @return Epoch seconds, or {@link Long#MIN_VALUE} for text timestamps")
+        w("         */")
+        w(f"        public long {n}Epoch(){{ return {n}Epoch; }}")
+    w("    }")
+    w("")
+    w("    /**")
+    w("     * Decodes a text TLM line into {@code f}.")
+    w("     *")
+    w("     * @param line Line, with or without the trailing newline")
+    w("     * @param f Frame to fill")
+    w("     * @return true if the line matched the schema; {@code f} may be partially updated otherwise")
+    w("     */")
+    w("    public static boolean decodeText(CharSequence line, Frame f){")
+    w("        return line != null && decodeText(line, 0, line.length(), f);")
+    w("    }")
+    w("")
+    for param, ch, doc in JAVA_SOURCES:
+        gen_java_text(w, fields, param, ch, doc)
+    w("    /**")
+    w("     * Decodes one binary frame (full or delta) starting at {@code off}.")
+    w("     * A delta frame only overwrites the fields it carries.")
+    w("     *")
+    w("     * @param b Buffer holding the frame")
+    w("     * @param off Offset of the magic byte")
+    w("     * @param len Number of valid bytes from {@code off}")
+    w("     * @param f Frame to update")
+    w("     * @return Bytes consumed, 0 if the frame is incomplete, or -1 if malformed")
+    w("     */")
+    w("    public static int decodeBinary(byte[] b, int off, int len, Frame f){")
+    w("        if (len < 3) return 0;")
+    w("        if ((b[off] & 0xFF) != MAGIC) return -1;")
+    w("        int size = 3 + (b[off+2] & 0xFF);")
+    w("        if (len < size) return 0;")
+    w("        int p = off + 3, mask;")
+    w("        if (b[off+1] == 'F') mask = FULL_MASK;")
+    w("        else if (b[off+1] == 'D' && size > 3) mask = b[p++] & FULL_MASK;")
+    w("        else return -1;")
+    w("        int need = " + "\n                 + ".join(f"((mask & {1 << i}) != 0 ? {KINDS[k]} : 0)" for i, (_, k) in enumerate(fields)) + ";")
+    w("        if (p + need != off + size) return -1;")
+    for i, (name, kind) in enumerate(fields):
+        if kind == "INT":
+            w(f"        if ((mask & {1 << i}) != 0){{ f.{name} = (int) le(b, p, 4); p += 4; }}")
+        elif kind == "DIR":
+            w(f"        if ((mask & {1 << i}) != 0){{ f.{name} = (char) (b[p] & 0xFF); p += 1; }}")
+        else:
+            w(f"        if ((mask & {1 << i}) != 0){{ f.{name}Epoch = le(b, p, 8); f.{name}Len = 0; p += 8; }}")
+    w("        return size;")
+    w("    }")
+    w("")
+    for param, ch, _ in JAVA_SOURCES:
+        gen_java_helpers(w, param, ch)
+    w("    private static long le(byte[] b, int p, int n){")
+    w("        long v = 0;")
+    w("        for (int i = n - 1; i >= 0; i--) v = (v << 8) | (b[p+i] & 0xFF);")
+    w("        return n == 4 ? (int) v : v;")
+    w("    }")
+    w("}")
+    return "\n".join(o) + "\n"
+
+
+# ---------- Python ----------
+def gen_python(fields):
+    o = []
+    w = o.append
+    w("# GENERATED by server/gen_schema.py from server/tlm_schema.def - do not edit.")
+    w('"""TLM decoders specialized for the server\'s telemetry schema."""')
+    w("import struct")
+    w("import time")
+    w("")
+    w("MAGIC = 0xA7")
+    w("FIELDS = (" + ", ".join(f'"{n}"' for n, _ in fields) + ("," if len(fields) == 1 else "") + ")")
+    w(f"FULL_MASK = 0x{(1 << len(fields)) - 1:X}")
+    w("")
+    w("")
+    w("def _int_end(s, p):")
+    w('    """End of the integer at s[p:], or p if there is none (a lone "-" is not one)."""')
+    w("    n = len(s)")
+    w("    q = p + 1 if p < n and s[p] == '-' else p")
+    w("    e = q")
+    w("    while e < n and '0' <= s[e] <= '9':")
+    w("        e += 1")
+    w("    return e if e > q else p")
+    w("")
+    w("")
+    w("def parse_text(line):")
+    w('    """Decode a text TLM line into a dict, or return None if it does not match."""')
+    w("    line = line.rstrip()")
+    w("    p = 0")
+    for i, (name, kind) in enumerate(fields):
+        lab = label(i, name)
+        last = i == len(fields) - 1
+        w(f'    if not line.startswith("{lab}", p):')
+        w("        return None")
+        w(f"    p += {len(lab)}")
+        if kind == "INT":
+            w("    e = _int_end(line, p)")
+            w("    if e == p:")
+            w("        return None")
+            w(f"    v_{name} = int(line[p:e])")
+            w("    p = e")
+        elif kind == "DIR":
+            w(f"    v_{name} = line[p:p + 1]")
+            w("    p += 1")
+        else:
+            if last:
+                w("    e = len(line)")
+            else:
+                w("    e = line.find(';', p)")
+                w("    if e < 0:")
+                w("        return None")
+            w(f"    v_{name} = line[p:e]")
+            w("    p = e")
+    w("    if p != len(line):")
+    w("        return None")
+    w("    return {" + ", ".join(f'"{n}": v_{n}' for n, _ in fields) + "}")
+    w("")
+    w("")
+    w("def decode_binary(buf, frame):")
+    w('    """Apply one binary frame (full or delta) at the start of buf to the dict frame.')
+    w("")
+    w("    Returns bytes consumed, 0 if incomplete, or None if malformed; frame is")
+    w("    only updated from a frame whose length matches the fields it carries.")
+    w('    """')
+    w("    if len(buf) < 3:")
+    w("        return 0")
+    w("    if buf[0] != MAGIC:")
+    w("        return None")
+    w("    size = 3 + buf[2]")
+    w("    if len(buf) < size:")
+    w("        return 0")
+    w("    p = 3")
+    w("    if buf[1] == ord('F'):")
+    w("        mask = FULL_MASK")
+    w("    elif buf[1] == ord('D') and size > 3:")
+    w("        mask = buf[3] & FULL_MASK")
+    w("        p = 4")
+    w("    else:")
+    w("        return None")
+    w("    need = " + " + ".join(f"({KINDS[k]} if mask & {1 << i} else 0)" for i, (_, k) in enumerate(fields)))
+    w("    if p + need != size:")
+    w("        return None")
+    for i, (name, kind) in enumerate(fields):
+        w(f"    if mask & {1 << i}:")
+        if kind == "INT":
+            w(f'        frame["{name}"] = struct.unpack_from("<i", buf, p)[0]')
+            w("        p += 4")
+        elif kind == "DIR":
+            w(f'        frame["{name}"] = chr(buf[p])')
+            w("        p += 1")
+        else:
+            w("        try:")
+            w(f'            frame["{name}"] = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(struct.unpack_from("<q", buf, p)[0]))')
+            w("        except (OverflowError, OSError, ValueError):")
+            w("            return None")
+            w("        p += 8")
+    w("    return size")
+    return "\n".join(o) + "\n"
+
+
+def write(path, text):
+    with open(path, "w") as f:
+        f.write(text)
+    print("wrote", os.path.relpath(path, HERE))
+
+
+if __name__ == "__main__":
+    fields = load_schema(SCHEMA)
+    write(JAVA_OUT, gen_java(fields))
+    write(PY_OUT, gen_python(fields))
@@ -0,0 +1,374 @@
+// Autonomous Vehicle Project - telemetry history with a memory cap (see hist.h)
+//
+// Both tiers are FIFO lists of fixed-size blocks with increasing ids; only the
+// newest block of each list is open. Eviction takes the oldest full block, so
+// the cap always holds (the spill index, a few bytes per block, is the only
+// thing that grows with the spill file, and it is counted too). Queries copy
+// one block at a time under the lock and resume from its id, which stays valid
+// when a block moves from memory to the spill file in between.
+
+#define _GNU_SOURCE
+#include "hist.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HIST_ROLL_BLOCK 256   // rollup records per block
+
+typedef struct raw_blk  { struct raw_blk *next;  uint64_t id; int n; hist_cols_t c; } raw_blk_t;
+typedef struct roll_blk { struct roll_blk *next; uint64_t id; int n; hist_rollup_t r[HIST_ROLL_BLOCK]; } roll_blk_t;
+typedef struct { uint64_t id; int64_t t0, t1; } spill_ent_t;   // entry k: block at k*sizeof(hist_cols_t)
+
+struct hist {
+    pthread_mutex_t mx; size_t cap, mem;
+    raw_blk_t  *raw, *raw_tail;   uint64_t raw_id;    // oldest .. newest (open)
+    roll_blk_t *roll, *roll_tail; uint64_t roll_id;
+    hist_rollup_t cur; int have_cur;                   // bucket being accumulated
+    int fd; spill_ent_t *spill; long nspill, spill_cap;
+    int64_t lost_to;                                   // newest raw sample evicted without a copy
+    int64_t last_ts;                                   // newest ts added (hist_add clamps to it)
+    hist_stats_t st;
+};
+
+// ---------- Eviction ----------
+static void raw_lost(hist_t *h, const raw_blk_t *b){ h->st.dropped+=b->n; h->lost_to=b->c.ts[b->n-1]; }
+
+static void spill_block(hist_t *h, const raw_blk_t *b){
+    if (h->nspill==h->spill_cap){
+        long nc=h->spill_cap ? h->spill_cap*2 : 64;
+        spill_ent_t *p=realloc(h->spill, (size_t)nc*sizeof(*p));
+        if (!p){ h->st.spill_errors++; raw_lost(h,b); return; }
+        h->mem+=(size_t)(nc-h->spill_cap)*sizeof(*p); h->spill=p; h->spill_cap=nc;
+    }
+    off_t off=(off_t)h->nspill*(off_t)sizeof(hist_cols_t);
+    if (pwrite(h->fd, &b->c, sizeof(b->c), off)!=(ssize_t)sizeof(b->c)){ h->st.spill_errors++; raw_lost(h,b); return; }
+    h->spill[h->nspill++]=(spill_ent_t){ b->id, b->c.ts[0], b->c.ts[b->n-1] };
+    h->st.spilled+=b->n; h->st.spill_blocks++;
+}
+
+// Frees the oldest full block, raw before rollups; 0 when there is none.
+static int evict(hist_t *h){
+    if (h->raw && h->raw->n==HIST_BLOCK){
+        raw_blk_t *b=h->raw;
+        if (h->fd>=0) spill_block(h,b); else raw_lost(h,b);
+        h->raw=b->next; if (!h->raw) h->raw_tail=NULL;
+        h->st.raw-=b->n; h->mem-=sizeof(*b); free(b);
+        return 1;
+    }
+    if (h->roll && h->roll->n==HIST_ROLL_BLOCK){
+        roll_blk_t *b=h->roll;
+        h->roll=b->next; if (!h->roll) h->roll_tail=NULL;
+        h->st.rollups-=b->n; h->st.rollups_dropped+=b->n; h->mem-=sizeof(*b); free(b);
+        return 1;
+    }
+    return 0;
+}
+
+static void *blk_alloc(hist_t *h, size_t size){
+    while (h->mem+size > h->cap && evict(h));
+    void *p=malloc(size);
+    if (p) h->mem+=size;
+    return p;
+}
+
+// ---------- Store ----------
+hist_t *hist_create(size_t cap, const char *spill){
+    hist_t *h=calloc(1,sizeof(*h));
+    if (!h) return NULL;
+    size_t min=sizeof(*h)+sizeof(raw_blk_t)+sizeof(roll_blk_t)+64*sizeof(spill_ent_t);
+    h->cap=cap>min ? cap : min; h->mem=sizeof(*h); h->fd=-1; h->lost_to=INT64_MIN;
+    if (spill && (h->fd=open(spill, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644))<0){ int e=errno; free(h); errno=e; return NULL; }
+    pthread_mutex_init(&h->mx, NULL);
+    return h;
+}
+
+void hist_destroy(hist_t *h){
+    if (!h) return;
+    while (h->raw){ raw_blk_t *n=h->raw->next; free(h->raw); h->raw=n; }
+    while (h->roll){ roll_blk_t *n=h->roll->next; free(h->roll); h->roll=n; }
+    if (h->fd>=0) close(h->fd);
+    free(h->spill); pthread_mutex_destroy(&h->mx); free(h);
+}
+
+#define ROLL_INIT_INT(r, s, name)  ((r)->name##_min=(r)->name##_max=(s)->name, (r)->name##_sum=(s)->name)
+#define ROLL_INIT_DIR(r, s, name)  ((r)->name=(s)->name)
+#define ROLL_INIT_TIME(r, s, name) ((r)->name=(s)->name-(s)->name%HIST_ROLLUP_S)
+#define ROLL_ADD_INT(r, s, name)   ((s)->name<(r)->name##_min ? (r)->name##_min=(s)->name : 0, \
+                                    (s)->name>(r)->name##_max ? (r)->name##_max=(s)->name : 0, (r)->name##_sum+=(s)->name)
+#define ROLL_ADD_DIR(r, s, name)   ((r)->name=(s)->name)
+#define ROLL_ADD_TIME(r, s, name)  ((void)0)
+
+static void roll_push(hist_t *h, const hist_rollup_t *r){
+    if (!h->roll_tail || h->roll_tail->n==HIST_ROLL_BLOCK){
+        roll_blk_t *b=blk_alloc(h, sizeof(*b));
+        if (!b){ h->st.rollups_dropped++; return; }
+        b->next=NULL; b->id=++h->roll_id; b->n=0;
+        if (h->roll_tail) h->roll_tail->next=b; else h->roll=b;
+        h->roll_tail=b;
+    }
+    h->roll_tail->r[h->roll_tail->n++]=*r; h->st.rollups++;
+}
+
+long hist_add(hist_t *h, const tlm_sample_t *in){
+    pthread_mutex_lock(&h->mx);
+    size_t before=h->mem;
+    tlm_sample_t clamped=*in; const tlm_sample_t *s=&clamped;
+    if (clamped.ts<h->last_ts) clamped.ts=h->last_ts; else h->last_ts=clamped.ts;
+    int64_t bucket=s->ts - s->ts%HIST_ROLLUP_S;
+    if (h->have_cur && h->cur.ts!=bucket){ roll_push(h,&h->cur); h->have_cur=0; }
+    if (!h->have_cur){
+        h->cur.n=1; h->have_cur=1;
+#define TLM_FIELD(name, kind) ROLL_INIT_##kind(&h->cur, s, name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    } else {
+        h->cur.n++;
+#define TLM_FIELD(name, kind) ROLL_ADD_##kind(&h->cur, s, name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    }
+    if (!h->raw_tail || h->raw_tail->n==HIST_BLOCK){
+        raw_blk_t *b=blk_alloc(h, sizeof(*b));
+        if (!b){ h->st.dropped++; h->lost_to=s->ts; goto out; }
+        b->next=NULL; b->id=++h->raw_id; b->n=0;
+        if (h->raw_tail) h->raw_tail->next=b; else h->raw=b;
+        h->raw_tail=b;
+    }
+    raw_blk_t *b=h->raw_tail;
+#define TLM_FIELD(name, kind) b->c.name[b->n]=s->name;
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    b->n++; h->st.raw++;
+out:
+    pthread_mutex_unlock(&h->mx);
+    return (long)h->mem-(long)before;
+}
+
+size_t hist_mem(hist_t *h){
+    pthread_mutex_lock(&h->mx); size_t m=h->mem; pthread_mutex_unlock(&h->mx);
+    return m;
+}
+
+void hist_stats(hist_t *h, hist_stats_t *st){
+    pthread_mutex_lock(&h->mx); *st=h->st; pthread_mutex_unlock(&h->mx);
+}
+
+int hist_span(hist_t *h, int64_t *t0, int64_t *t1){
+    pthread_mutex_lock(&h->mx);
+    int ok = h->raw_tail && h->raw_tail->n;
+    if (ok){
+        *t0 = h->nspill ? h->spill[0].t0 : h->raw->c.ts[0];
+        *t1 = h->raw_tail->c.ts[h->raw_tail->n-1];
+    }
+    pthread_mutex_unlock(&h->mx);
+    return ok;
+}
+
+// ---------- Query ----------
+static void cols_copy(hist_cols_t *dst, const hist_cols_t *src, int n){
+#define TLM_FIELD(name, kind) memcpy(dst->name, src->name, (size_t)n*sizeof(src->name[0]));
+#include "tlm_schema.def"
+#undef TLM_FIELD
+}
+
+// First row with ts >= t (n if none)
+static int lower_bound(const int64_t *ts, int n, int64_t t){
+    int lo=0, hi=n;
+    while (lo<hi){ int mid=(lo+hi)/2; if (ts[mid]<t) lo=mid+1; else hi=mid; }
+    return lo;
+}
+
+long hist_count(hist_t *h, int64_t from, int64_t to){
+    if (from>to) return 0;
+    double n=0;
+    pthread_mutex_lock(&h->mx);
+    for (long k=0; k<h->nspill && h->spill[k].t0<=to; k++){   // full blocks; the ends are interpolated
+        const spill_ent_t *e=&h->spill[k];
+        if (e->t1<from) continue;
+        if (e->t0>=from && e->t1<=to) n+=HIST_BLOCK;
+        else n+=(double)HIST_BLOCK*(double)((e->t1<to ? e->t1 : to) - (e->t0>from ? e->t0 : from) + 1)/(double)(e->t1-e->t0+1);
+    }
+    for (const raw_blk_t *b=h->raw; b && (!b->n || b->c.ts[0]<=to); b=b->next)
+        if (b->n && b->c.ts[b->n-1]>=from) n+=lower_bound(b->c.ts,b->n,to+1)-lower_bound(b->c.ts,b->n,from);
+    pthread_mutex_unlock(&h->mx);
+    return (long)(n+0.5);
+}
+
+// Copies the next block after id *cursor that ends at or after from into buf
+// (reading it from the spill file if it is there). Returns its row count, 0 at the end, -1 on a read error.
+static int next_raw(hist_t *h, uint64_t *cursor, int64_t from, hist_cols_t *buf){
+    pthread_mutex_lock(&h->mx);
+    long lo=0, hi=h->nspill;
+    while (lo<hi){ long mid=(lo+hi)/2; if (h->spill[mid].id<=*cursor) lo=mid+1; else hi=mid; }
+    hi=h->nspill;   // t1 grows with id too: skip blocks that end before from
+    while (lo<hi){ long mid=(lo+hi)/2; if (h->spill[mid].t1<from) lo=mid+1; else hi=mid; }
+    if (lo<h->nspill){
+        *cursor=h->spill[lo].id;
+        off_t off=(off_t)lo*(off_t)sizeof(hist_cols_t); int fd=h->fd;
+        pthread_mutex_unlock(&h->mx);
+        return pread(fd, buf, sizeof(*buf), off)==(ssize_t)sizeof(*buf) ? HIST_BLOCK : -1;   // spilled blocks are full
+    }
+    const raw_blk_t *b=h->raw;
+    while (b && (b->id<=*cursor || !b->n || b->c.ts[b->n-1]<from)) b=b->next;
+    int n=0;
+    if (b){ *cursor=b->id; n=b->n; cols_copy(buf, &b->c, n); }
+    pthread_mutex_unlock(&h->mx);
+    return n;
+}
+
+// Same for rollup blocks; the open bucket comes last, as a block of one.
+static int next_rollups(hist_t *h, uint64_t *cursor, hist_rollup_t *buf){
+    pthread_mutex_lock(&h->mx);
+    const roll_blk_t *b=h->roll;
+    while (b && b->id<=*cursor) b=b->next;
+    int n=0;
+    if (b){ *cursor=b->id; n=b->n; memcpy(buf, b->r, (size_t)n*sizeof(*buf)); }
+    else if (h->have_cur && *cursor!=UINT64_MAX){ *cursor=UINT64_MAX; buf[0]=h->cur; n=1; }
+    pthread_mutex_unlock(&h->mx);
+    return n;
+}
+
+int hist_query(hist_t *h, int64_t from, int64_t to, hist_rollup_fn on_rollup, hist_raw_fn on_raw, void *user){
+    if (from>to) return 0;
+    hist_cols_t *buf=malloc(sizeof(*buf)); hist_rollup_t *rb=malloc(HIST_ROLL_BLOCK*sizeof(*rb));
+    int rc=0;
+    if (!buf || !rb){ free(buf); free(rb); errno=ENOMEM; return -1; }
+
+    pthread_mutex_lock(&h->mx); int64_t lost_to=h->lost_to; pthread_mutex_unlock(&h->mx);
+
+    uint64_t cursor=0; int n, done=0, stop=0;
+    while (!done && !stop && (n=next_rollups(h,&cursor,rb))>0)
+        for (int i=0;i<n;i++){
+            if (rb[i].ts>to || rb[i].ts>lost_to){ done=1; break; }
+            if (rb[i].ts+HIST_ROLLUP_S>from && (stop=on_rollup(user,&rb[i]))) break;
+        }
+    cursor=0;
+    while (!stop && (n=next_raw(h,&cursor,from,buf))!=0){
+        if (n<0){ rc=-1; break; }
+        int i0=lower_bound(buf->ts,n,from), i1=lower_bound(buf->ts,n,to+1);
+        if (i0<i1) stop=on_raw(user,buf,i0,i1);
+        if (i1<n) break;   // past to
+    }
+    free(buf); free(rb);
+    return rc;
+}
+
+// ---------- Downsampling ----------
+typedef struct { double x, y; tlm_sample_t s; } lt_pt_t;
+// Rows of one bucket; the sums cover every row fed, including thinned ones
+typedef struct { lt_pt_t *p; int n; int64_t b; double sx, sy; long cnt; } lt_bucket_t;
+
+struct hist_lttb {
+    double per_row; int last_b; int field;     // buckets per row between the first and last one
+    hist_sample_fn out; void *user;
+    long scanned; int started, stopped;
+    lt_pt_t a, last;                           // last point emitted, last row fed
+    lt_bucket_t cur, next;                     // cur: complete, waiting for next's average
+};
+
+#define LTTB_INT_INT  1
+#define LTTB_INT_DIR  0
+#define LTTB_INT_TIME 0
+int hist_field(const char *name){
+#define TLM_FIELD(name_, kind) if (LTTB_INT_##kind && strcmp(name, #name_)==0) return TLM_F_##name_;
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    return -1;
+}
+
+static double col_value(const hist_cols_t *c, int field, int i){
+    switch(field){
+#define TLM_FIELD(name, kind) case TLM_F_##name: return (double)c->name[i];
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    }
+    return 0;
+}
+
+hist_lttb_t *hist_lttb_new(long rows, int points, int field, hist_sample_fn out, void *user){
+    hist_lttb_t *lt=calloc(1,sizeof(*lt));
+    if (!lt) return NULL;
+    lt->cur.p=malloc(HIST_LTTB_BUF*sizeof(lt_pt_t)); lt->next.p=malloc(HIST_LTTB_BUF*sizeof(lt_pt_t));
+    if (!lt->cur.p || !lt->next.p){ hist_lttb_free(lt); return NULL; }
+    lt->per_row = rows>2 ? (double)(points-2)/(double)(rows-2) : 1; lt->last_b=points-3;
+    lt->field=field; lt->out=out; lt->user=user;
+    return lt;
+}
+
+void hist_lttb_free(hist_lttb_t *lt){
+    if (!lt) return;
+    free(lt->cur.p); free(lt->next.p); free(lt);
+}
+
+long hist_lttb_scanned(const hist_lttb_t *lt){ return lt->scanned; }
+
+static void lt_emit(hist_lttb_t *lt, const lt_pt_t *p){
+    if (!lt->stopped) lt->stopped=lt->out(lt->user, &p->s);
+    lt->a=*p;
+}
+
+// The point of b spanning the largest triangle with the last emitted point and (cx, cy)
+static const lt_pt_t *lt_select(const hist_lttb_t *lt, const lt_bucket_t *b, double cx, double cy){
+    const lt_pt_t *a=&lt->a, *best=&b->p[0]; double best_area=-1;
+    for (int i=0;i<b->n;i++){
+        const lt_pt_t *p=&b->p[i];
+        double area=(a->x-cx)*(p->y-a->y) - (a->x-p->x)*(cy-a->y);   // twice the signed area
+        if (area<0) area=-area;
+        if (area>best_area){ best_area=area; best=p; }
+    }
+    return best;
+}
+
+// Keeps the lowest and highest row of every 8, in order: a full buffer shrinks to a quarter.
+static void lt_thin(lt_bucket_t *b){
+    int k=0;
+    for (int g=0; g+8<=b->n; g+=8){
+        int lo=g, hi=g;
+        for (int i=g+1;i<g+8;i++){ if (b->p[i].y<b->p[lo].y) lo=i; if (b->p[i].y>b->p[hi].y) hi=i; }
+        if (lo>hi){ int t=lo; lo=hi; hi=t; }
+        b->p[k++]=b->p[lo]; if (hi!=lo) b->p[k++]=b->p[hi];
+    }
+    b->n=k;
+}
+
+int hist_lttb_feed(void *user, const hist_cols_t *c, int i0, int i1){
+    hist_lttb_t *lt=user;
+    for (int i=i0; i<i1 && !lt->stopped; i++){
+        lt_pt_t pt={ (double)lt->scanned++, col_value(c,lt->field,i), {0} };
+#define TLM_FIELD(name, kind) pt.s.name=c->name[i];
+#include "tlm_schema.def"
+#undef TLM_FIELD
+        lt->last=pt;
+        if (!lt->started){ lt->started=1; lt_emit(lt,&pt); continue; }
+        int64_t b=(int64_t)(pt.x-1 < 0 ? 0 : (pt.x-1)*lt->per_row);
+        if (b>lt->last_b) b=lt->last_b;   // rows added after the count
+        if (lt->next.n && b!=lt->next.b){   // next is complete: cur can be decided
+            if (lt->cur.n) lt_emit(lt, lt_select(lt, &lt->cur, lt->next.sx/lt->next.cnt, lt->next.sy/lt->next.cnt));
+            lt_bucket_t t=lt->cur; lt->cur=lt->next; lt->next=t;
+            lt->next.n=0; lt->next.sx=lt->next.sy=0; lt->next.cnt=0;
+        }
+        if (lt->next.n==HIST_LTTB_BUF) lt_thin(&lt->next);
+        lt->next.p[lt->next.n++]=pt; lt->next.b=b;
+        lt->next.sx+=pt.x; lt->next.sy+=pt.y; lt->next.cnt++;
+    }
+    return lt->stopped;
+}
+
+int hist_lttb_end(hist_lttb_t *lt){
+    if (!lt->started) return lt->stopped;
+    lt_pt_t last=lt->last;
+    if (lt->cur.n){
+        double cx = lt->next.cnt ? lt->next.sx/lt->next.cnt : last.x, cy = lt->next.cnt ? lt->next.sy/lt->next.cnt : last.y;
+        lt_emit(lt, lt_select(lt, &lt->cur, cx, cy));
+    }
+    if (lt->next.n){
+        const lt_pt_t *p=lt_select(lt, &lt->next, last.x, last.y);
+        if (p->x!=last.x) lt_emit(lt, p);
+    }
+    if (lt->a.x!=last.x) lt_emit(lt, &last);
+    return lt->stopped;
+}
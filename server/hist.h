@@ -0,0 +1,98 @@
+// Autonomous Vehicle Project - telemetry history with a memory cap (part of libavt)
+//
+// Keeps every broadcast sample in two tiers under one byte cap:
+//   raw      columnar blocks of HIST_BLOCK samples (one array per schema field)
+//   rollups  one record per HIST_ROLLUP_S-second bucket: count, min/sum/max of
+//            every INT field, last DIR, bucket start for TIME
+// When the cap is reached the oldest full raw block is evicted first, either
+// appended to a spill file (the on-disk segment store) or dropped; rollups are
+// evicted only once no evictable raw block is left, so they outlive raw data.
+// Queries walk the tiers by block id: spilled blocks are read back from the
+// file, so a range reads the same whether its raw samples are in memory or on
+// disk, and rollups stand in for the span whose raw samples were dropped
+// (the boundary minute can show up both ways).
+//
+// Spill file: full blocks back to back, each a hist_cols_t in host byte order;
+// the index lives in memory and the file is truncated when the store is created.
+
+#ifndef HIST_H
+#define HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tlm.h"
+
+#define HIST_BLOCK     1024   // samples per raw block
+#define HIST_ROLLUP_S  60     // rollup bucket, seconds
+
+typedef struct {
+#define TLM_FIELD(name, kind) TLM_CTYPE_##kind name[HIST_BLOCK];
+#include "tlm_schema.def"
+#undef TLM_FIELD
+} hist_cols_t;
+
+#define HIST_ROLL_INT(name)  int32_t name##_min, name##_max; int64_t name##_sum;
+#define HIST_ROLL_DIR(name)  char name;      // last in the bucket
+#define HIST_ROLL_TIME(name) int64_t name;   // bucket start
+typedef struct {
+    int32_t n;
+#define TLM_FIELD(name, kind) HIST_ROLL_##kind(name)
+#include "tlm_schema.def"
+#undef TLM_FIELD
+} hist_rollup_t;
+
+typedef struct {
+    long raw, rollups;               // samples / rollup records held in memory
+    long spilled, spill_blocks;      // raw samples / blocks in the spill file
+    long dropped, rollups_dropped;   // evicted without a copy
+    long spill_errors;
+} hist_stats_t;
+
+typedef struct hist hist_t;
+
+// cap: bytes for both tiers and the spill index (raised to the minimum of one
+// block each); spill: file path, or NULL to drop evicted raw blocks.
+hist_t *hist_create(size_t cap, const char *spill);   // NULL (errno set) on failure
+void    hist_destroy(hist_t *h);
+// Appends one sample; thread-safe. A ts older than the newest one added is
+// raised to it, so the store stays in time order.
+// Returns the change in bytes held, for memory accounting.
+long    hist_add(hist_t *h, const tlm_sample_t *s);
+size_t  hist_mem(hist_t *h);
+void    hist_stats(hist_t *h, hist_stats_t *st);
+// Oldest and newest raw timestamps held (memory or spill file); 0 if there are none.
+int     hist_span(hist_t *h, int64_t *t0, int64_t *t1);
+// Raw samples held in [from, to]: exact for blocks in memory; a spilled block the
+// range only partly covers is estimated from its time span, without reading it.
+long    hist_count(hist_t *h, int64_t from, int64_t to);
+
+// Query callbacks return nonzero to stop. Raw samples come as column blocks:
+// rows i0..i1-1 of c, all inside the range, in time order.
+typedef int (*hist_raw_fn)(void *user, const hist_cols_t *c, int i0, int i1);
+typedef int (*hist_rollup_fn)(void *user, const hist_rollup_t *r);
+// Walks [from, to] (epoch seconds, inclusive): first the rollups of buckets
+// whose raw samples were (at least partly) dropped, then the raw samples still
+// held in memory or the spill file. Never holds the store's lock while calling back, so a
+// slow consumer does not hold up hist_add. Returns -1 on a spill read error.
+int     hist_query(hist_t *h, int64_t from, int64_t to, hist_rollup_fn on_rollup, hist_raw_fn on_raw, void *user);
+
+// ---- Downsampling ----
+// Largest-Triangle-Three-Buckets over one INT field in a single streaming pass:
+// pass hist_lttb_feed as hist_query's raw callback and about `points` samples
+// (first and last included) reach out. Buckets split the rows evenly by
+// ordinal, so size them with hist_count over the same range first; x is the
+// ordinal too, so samples sharing a second still spread out. A bucket holding
+// more than HIST_LTTB_BUF rows is thinned to per-group min/max rows first,
+// which keeps memory bounded and the peaks visible.
+#define HIST_LTTB_BUF 2048
+typedef int (*hist_sample_fn)(void *user, const tlm_sample_t *s);
+typedef struct hist_lttb hist_lttb_t;
+int          hist_field(const char *name);   // TLM_F_* of an INT field, -1 if none
+hist_lttb_t *hist_lttb_new(long rows, int points, int field, hist_sample_fn out, void *user);
+int          hist_lttb_feed(void *lt, const hist_cols_t *c, int i0, int i1);   // a hist_raw_fn
+int          hist_lttb_end(hist_lttb_t *lt);             // emits what is pending; nonzero if out stopped
+long         hist_lttb_scanned(const hist_lttb_t *lt);   // rows fed
+void         hist_lttb_free(hist_lttb_t *lt);
+
+#endif
@@ -0,0 +1,360 @@
+// Autonomous Vehicle Project - load generator
+// Build: make loadgen
+// Run:   ./loadgen <host> <port> <capture> [--speed N] [--copies K] [--loop] [--auth-pass PASS]
+//        ./loadgen --latency N [--auth-pass PASS] <host> <port>
+//        ./loadgen --slow BPS [--seconds S] <host> <port>
+//
+// Replays a capture written by `server --record` (rec.h) against a server:
+// every recorded session becomes K concurrent TCP connections that open, send
+// their lines and close on the recorded schedule, compressed N times
+// (--speed 1 is real time). One thread, epoll; replies and telemetry are
+// drained and counted so the server never blocks on us. Reports what was sent
+// and received and how far behind schedule the generator fell. Captures store
+// AUTH passwords as "*"; they are sent as --auth-pass (default admin123).
+//
+// --latency N measures the control path instead: one admin connection sends N
+// SPEED UP / SLOW DOWN commands back to back, each after the previous reply,
+// and reports the round-trip percentiles (telemetry in between is skipped).
+//
+// --slow BPS is a slow observer: a 4 KiB receive buffer, read at BPS bytes/s
+// for S seconds (default 30). It reports how old each TEXT frame was on
+// arrival (receipt time minus the frame's ts, so 1 s resolution), to compare
+// the server with and without --notsent-lowat, and the RATE notices it got
+// (--rate-min).
+
+#define _GNU_SOURCE
+#include "rec.h"
+#include "avt.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct { uint64_t sess; int used; int *fd; } lg_sess_t;   // fd[copies], -1 when closed
+typedef struct { char *buf; size_t len, cap; int armed; } lg_conn_t;   // output not yet accepted by the socket
+
+static struct {
+    double speed; int copies; int loop; long latency, slow, seconds; const char *auth_pass;
+} g_opt = { .speed=1.0, .copies=1, .seconds=30, .auth_pass="admin123" };
+
+static volatile sig_atomic_t g_stop = 0;
+static struct sockaddr_in g_dst;
+static int g_ep = -1;
+static lg_sess_t *g_tab = NULL; static size_t g_cap = 0;
+static lg_conn_t *g_conn = NULL; static int g_nconn = 0;   // indexed by fd
+
+static struct {
+    long events, opened, connect_fail, closed_by_peer, lines, send_fail, rx_lines;
+    long long rx_bytes; double max_lag, sum_lag;
+} g_st;
+
+static void on_sigint(int sig){ (void)sig; g_stop = 1; }
+
+static double now_s(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+// ---------- Session table (open addressing on the recorded id) ----------
+static lg_sess_t *sess_find(uint64_t id){
+    size_t mask=g_cap-1, i=(size_t)(id*11400714819323198485ull)>>7 & mask;
+    for (;; i=(i+1)&mask){
+        if (!g_tab[i].used){
+            g_tab[i].used=1; g_tab[i].sess=id;
+            g_tab[i].fd=malloc(sizeof(int)*(size_t)g_opt.copies);
+            for (int c=0; c<g_opt.copies; c++) g_tab[i].fd[c]=-1;
+            return &g_tab[i];
+        }
+        if (g_tab[i].sess==id) return &g_tab[i];
+    }
+}
+
+// ---------- Connections ----------
+static void conn_arm(int fd, int out){
+    if (g_conn[fd].armed==out) return;
+    struct epoll_event ev={ .events=EPOLLIN|(out?EPOLLOUT:0), .data.fd=fd };
+    epoll_ctl(g_ep, EPOLL_CTL_MOD, fd, &ev);
+    g_conn[fd].armed=out;
+}
+
+static void conn_close(int fd){
+    epoll_ctl(g_ep, EPOLL_CTL_DEL, fd, NULL); close(fd);
+    g_conn[fd].len=0; g_conn[fd].armed=0;
+}
+
+// Non-blocking connect, so a full accept backlog delays only this connection, not the schedule.
+static int conn_open(void){
+    int fd=socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
+    if (fd<0) return -1;
+    if (fd>=g_nconn){
+        int n=g_nconn?g_nconn:1024; while(n<=fd) n*=2;
+        lg_conn_t *c=realloc(g_conn, sizeof(*c)*(size_t)n);
+        if (!c){ close(fd); return -1; }
+        memset(c+g_nconn, 0, sizeof(*c)*(size_t)(n-g_nconn)); g_conn=c; g_nconn=n;
+    }
+    int one=1; setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd,(struct sockaddr*)&g_dst,sizeof(g_dst))<0 && errno!=EINPROGRESS){ close(fd); return -1; }
+    struct epoll_event ev={ .events=EPOLLIN|EPOLLOUT, .data.fd=fd };
+    epoll_ctl(g_ep, EPOLL_CTL_ADD, fd, &ev);
+    g_conn[fd].armed=1;
+    return fd;
+}
+
+static void conn_flush(int fd){
+    lg_conn_t *c=&g_conn[fd];
+    while (c->len){
+        ssize_t k=send(fd, c->buf, c->len, MSG_NOSIGNAL);
+        if (k<0){ if (errno==EAGAIN || errno==ENOTCONN || errno==EINPROGRESS) break; g_st.send_fail++; c->len=0; break; }
+        memmove(c->buf, c->buf+k, c->len-(size_t)k); c->len-=(size_t)k;
+    }
+    conn_arm(fd, c->len>0);
+}
+
+static void conn_send(int fd, const char *data, size_t len){
+    lg_conn_t *c=&g_conn[fd];
+    if (c->len+len > c->cap){
+        size_t n=c->cap?c->cap:4096; while(n<c->len+len) n*=2;
+        char *b=realloc(c->buf, n);
+        if (!b){ g_st.send_fail++; return; }
+        c->buf=b; c->cap=n;
+    }
+    memcpy(c->buf+c->len, data, len); c->len+=len;
+    conn_flush(fd);
+}
+
+// Drains whatever the server sent; waits at most timeout_ms.
+static void pump(int timeout_ms){
+    struct epoll_event evs[256]; static char buf[65536];
+    int n=epoll_wait(g_ep, evs, 256, timeout_ms);
+    for (int i=0; i<n; i++){
+        int fd=evs[i].data.fd;
+        if (evs[i].events & EPOLLOUT) conn_flush(fd);
+        if (!(evs[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP))) continue;
+        for (;;){
+            ssize_t k=recv(fd, buf, sizeof(buf), 0);
+            if (k>0){
+                g_st.rx_bytes+=k;
+                for (const char *p=buf; (p=memchr(p,'\n',(size_t)(buf+k-p))); p++) g_st.rx_lines++;
+                continue;
+            }
+            if (k==0 || (errno!=EAGAIN && errno!=EINTR)){
+                if (k==0) g_st.closed_by_peer++; else g_st.connect_fail++;
+                epoll_ctl(g_ep, EPOLL_CTL_DEL, fd, NULL); g_conn[fd].len=0; g_conn[fd].armed=0;
+            }
+            break;
+        }
+    }
+}
+
+static void apply(const rec_event_t *ev){
+    lg_sess_t *s=sess_find(ev->sess);
+    for (int c=0; c<g_opt.copies; c++){
+        int *fd=&s->fd[c];
+        if (ev->event==AVT_REC_CLOSE){ if (*fd>=0){ conn_close(*fd); *fd=-1; } continue; }
+        if (*fd<0){
+            if ((*fd=conn_open())<0){ g_st.connect_fail++; continue; }
+            g_st.opened++;
+        }
+        if (ev->event!=AVT_REC_LINE) continue;
+        char line[4200]; size_t len=ev->len<4096?ev->len:4096;
+        memcpy(line, ev->line, len);
+        if (len>7 && memmem(line,len,"AUTH ",5) && memcmp(line+len-2," *",2)==0)   // redacted (rec.h), maybe after @<key>
+            len+=(size_t)snprintf(line+len-1, 64, "%.63s", g_opt.auth_pass)-1;
+        line[len++]='\n';
+        conn_send(*fd, line, len); g_st.lines++;
+    }
+}
+
+// ---------- Latency mode ----------
+// Reads until the next reply line ("OK ..." / "ERR ..."); 0 on success.
+static int read_reply(int fd, char *buf, size_t cap, size_t *len){
+    for (;;){
+        char *nl;
+        while ((nl=memchr(buf, '\n', *len))){
+            size_t k=(size_t)(nl-buf)+1;
+            int reply = (k>=3 && memcmp(buf,"OK ",3)==0) || (k>=4 && memcmp(buf,"ERR ",4)==0);
+            memmove(buf, buf+k, *len-k); *len-=k;
+            if (reply) return 0;
+        }
+        if (*len==cap) *len=0;   // an over-long line: drop it
+        ssize_t k=recv(fd, buf+*len, cap-*len, 0);
+        if (k<=0) return -1;
+        *len+=(size_t)k;
+    }
+}
+
+static int cmp_double(const void *a, const void *b){
+    double x=*(const double*)a, y=*(const double*)b; return (x>y)-(x<y);
+}
+
+static int latency_run(long n){
+    int fd=socket(AF_INET, SOCK_STREAM, 0), one=1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (fd<0 || connect(fd,(struct sockaddr*)&g_dst,sizeof(g_dst))<0){ perror("connect"); return 1; }
+    static char buf[65536]; size_t len=0;
+    char login[96]; int ll=snprintf(login, sizeof(login), "AUTH admin %.63s\n", g_opt.auth_pass);
+    send(fd, login, (size_t)ll, MSG_NOSIGNAL);
+    if (read_reply(fd,buf,sizeof(buf),&len) || read_reply(fd,buf,sizeof(buf),&len)){ fprintf(stderr,"No reply from server\n"); return 1; }
+    double *rtt=malloc(sizeof(double)*(size_t)n);
+    if (!rtt){ fprintf(stderr,"Out of memory\n"); return 1; }
+    long done=0;
+    signal(SIGINT, on_sigint);
+    for (; done<n && !g_stop; done++){
+        const char *cmd = done&1 ? "SLOW DOWN\n" : "SPEED UP\n";
+        double t=now_s();
+        if (send(fd, cmd, strlen(cmd), MSG_NOSIGNAL)<0 || read_reply(fd,buf,sizeof(buf),&len)){ fprintf(stderr,"Connection lost\n"); break; }
+        rtt[done]=(now_s()-t)*1e6;
+    }
+    close(fd);
+    if (!done){ free(rtt); return 1; }
+    double sum=0; for (long i=0; i<done; i++) sum+=rtt[i];
+    qsort(rtt, (size_t)done, sizeof(double), cmp_double);
+    #define PCT(p) rtt[(long)((double)(done-1)*(p))]
+    printf("latency: %ld round trips, us: mean %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+           done, sum/(double)done, PCT(0.50), PCT(0.90), PCT(0.99), PCT(0.999), rtt[done-1]);
+    #undef PCT
+    free(rtt);
+    return 0;
+}
+
+// ---------- Slow reader ----------
+#define SLOW_RCVBUF 4096
+#define SLOW_SLICES 10   // reads per second
+
+static int slow_run(long bps, long seconds){
+    int fd=socket(AF_INET, SOCK_STREAM, 0), rcv=SLOW_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcv, sizeof(rcv));   // before connect, so the window stays small
+    if (fd<0 || connect(fd,(struct sockaddr*)&g_dst,sizeof(g_dst))<0){ perror("connect"); return 1; }
+    size_t cap=(size_t)(seconds*SLOW_SLICES+1)*64, n=0;   // ages; grown as needed
+    long *age=malloc(sizeof(long)*cap);
+    static char buf[65536]; size_t len=0; long bytes=0, rates=0, period_ms=0;
+    if (!age){ fprintf(stderr,"Out of memory\n"); return 1; }
+    signal(SIGINT, on_sigint);
+    double t0=now_s(), late_sum=0; long late_n=0;
+    for (long slice=0; slice<seconds*SLOW_SLICES && !g_stop; slice++){
+        double due=t0+(double)slice/SLOW_SLICES, now=now_s();
+        if (due>now){ struct timespec ts={ (time_t)(due-now), (long)((due-now-(double)(time_t)(due-now))*1e9) }; nanosleep(&ts,NULL); }
+        size_t want=(size_t)(bps/SLOW_SLICES); if (want<1) want=1;
+        if (want>sizeof(buf)-len) want=sizeof(buf)-len;
+        ssize_t k=recv(fd, buf+len, want, MSG_DONTWAIT);
+        if (k==0){ fprintf(stderr,"Server closed the connection\n"); break; }
+        if (k<0) continue;
+        len+=(size_t)k; bytes+=k;
+        time_t t=time(NULL); char *nl;
+        while ((nl=memchr(buf,'\n',len))){
+            *nl='\0';
+            const char *ts=strstr(buf,";ts="); struct tm tm={0};
+            if (sscanf(buf,"RATE period_ms=%ld",&period_ms)==1) rates++;
+            else if (strncmp(buf,"TLM ",4)==0 && ts && strptime(ts+4,"%Y-%m-%d %H:%M:%S",&tm)){
+                tm.tm_isdst=-1;
+                if (n==cap){ long *a=realloc(age,sizeof(long)*cap*2); if (!a) break; age=a; cap*=2; }
+                age[n]=(long)(t-mktime(&tm));
+                if (slice>=(seconds-5)*SLOW_SLICES){ late_sum+=(double)age[n]; late_n++; }
+                n++;
+            }
+            size_t used=(size_t)(nl-buf)+1; memmove(buf,buf+used,len-used); len-=used;
+        }
+        if (len==sizeof(buf)) len=0;
+    }
+    close(fd);
+    printf("slow:    %ld bytes in %.1f s (%ld B/s budget), %zu frames\n", bytes, now_s()-t0, bps, n);
+    if (rates) printf("rate:    %ld RATE notices, last period_ms=%ld\n", rates, period_ms);
+    if (n){
+        double sum=0; long max=0;
+        for (size_t i=0; i<n; i++){ sum+=(double)age[i]; if (age[i]>max) max=age[i]; }
+        printf("age:     s: mean %.1f, last 5 s %.1f, max %ld\n",
+               sum/(double)n, late_n ? late_sum/(double)late_n : 0.0, max);
+    }
+    free(age);
+    return 0;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr,"Usage: %s <host> <port> <capture> [--speed N] [--copies K] [--loop] [--auth-pass PASS]\n"
+                   "       %s --latency N [--auth-pass PASS] <host> <port>\n"
+                   "       %s --slow BPS [--seconds S] <host> <port>\n", prog, prog, prog);
+}
+
+int main(int argc, char **argv){
+    static const struct option longopts[] = {
+        {"speed",  required_argument, NULL, 's'},
+        {"copies", required_argument, NULL, 'c'},
+        {"loop",   no_argument,       NULL, 'l'},
+        {"latency", required_argument, NULL, 'n'},
+        {"slow",    required_argument, NULL, 'w'},
+        {"seconds", required_argument, NULL, 'S'},
+        {"auth-pass", required_argument, NULL, 'p'},
+        {NULL,0,NULL,0}
+    };
+    int opt;
+    while ((opt=getopt_long(argc,argv,"",longopts,NULL))!=-1){
+        switch(opt){
+        case 's': g_opt.speed=atof(optarg); break;
+        case 'c': g_opt.copies=atoi(optarg); break;
+        case 'l': g_opt.loop=1; break;
+        case 'n': g_opt.latency=atol(optarg); break;
+        case 'w': g_opt.slow=atol(optarg); break;
+        case 'S': g_opt.seconds=atol(optarg); break;
+        case 'p': g_opt.auth_pass=optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (argc-optind!=(g_opt.latency||g_opt.slow?2:3) || g_opt.speed<=0 || g_opt.copies<1 || g_opt.latency<0
+        || g_opt.slow<0 || g_opt.seconds<6){ usage(argv[0]); return 2; }
+
+    struct addrinfo hints={ .ai_family=AF_INET, .ai_socktype=SOCK_STREAM }, *ai;
+    if (getaddrinfo(argv[optind], argv[optind+1], &hints, &ai)!=0){ fprintf(stderr,"Cannot resolve %s\n", argv[optind]); return 2; }
+    memcpy(&g_dst, ai->ai_addr, sizeof(g_dst)); freeaddrinfo(ai);
+    if (g_opt.latency) return latency_run(g_opt.latency);
+    if (g_opt.slow) return slow_run(g_opt.slow, g_opt.seconds);
+
+    rec_reader_t r;
+    if (rec_open(&r, argv[optind+2])<0){ perror(argv[optind+2]); return 2; }
+    rec_event_t ev; long nsess=0, nev=0; int rc;
+    while ((rc=rec_next(&r,&ev))>0){ nev++; if (ev.event==AVT_REC_OPEN) nsess++; }
+    if (rc<0) fprintf(stderr,"warning: capture truncated after %ld events\n", nev);
+    for (g_cap=64; g_cap < (size_t)(nsess+1)*2; g_cap<<=1) ;
+    if (!(g_tab=calloc(g_cap, sizeof(*g_tab)))){ fprintf(stderr,"Out of memory\n"); return 2; }
+    g_ep=epoll_create1(0);
+    signal(SIGINT, on_sigint);   // --loop runs until Ctrl+C, then reports
+
+    double t0=now_s();
+    do {
+        rec_rewind(&r);
+        double base=now_s();
+        while (rec_next(&r,&ev)>0){
+            double due=base + (double)ev.t_us/1e6/g_opt.speed, now;
+            while ((now=now_s()) < due) pump((int)((due-now)*1000)+1);
+            double lag=now-due; g_st.sum_lag+=lag; if (lag>g_st.max_lag) g_st.max_lag=lag;
+            apply(&ev); g_st.events++;
+            pump(0);
+            if (g_stop) break;
+        }
+        // a looped capture restarts with fresh connections
+        for (size_t i=0; i<g_cap; i++) if (g_tab[i].used)
+            for (int c=0; c<g_opt.copies; c++) if (g_tab[i].fd[c]>=0){ conn_close(g_tab[i].fd[c]); g_tab[i].fd[c]=-1; }
+    } while (g_opt.loop && !g_stop);
+    double t=now_s()-t0;
+    for (double end=now_s()+0.5; now_s()<end; ) pump(50);
+
+    printf("capture: %ld events, %ld sessions x %d copies, speed %.1fx\n", nev, nsess, g_opt.copies, g_opt.speed);
+    printf("sent:    %ld connections (%ld failed/reset), %ld lines (%ld failed) in %.2f s = %.0f lines/s\n",
+           g_st.opened, g_st.connect_fail, g_st.lines, g_st.send_fail, t, (double)g_st.lines/t);
+    printf("recv:    %lld bytes, %ld lines, %ld closed by server\n", g_st.rx_bytes, g_st.rx_lines, g_st.closed_by_peer);
+    printf("lag:     max %.2f ms, mean %.3f ms behind schedule\n",
+           g_st.max_lag*1e3, g_st.events ? g_st.sum_lag*1e3/(double)g_st.events : 0.0);
+    rec_done(&r);
+    return 0;
+}
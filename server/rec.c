@@ -0,0 +1,202 @@
+// Autonomous Vehicle Project - session traffic capture (see rec.h)
+//
+// Writers append to one of two 64 KiB buffers under a mutex, so recording costs
+// a lock and a memcpy per line. A full buffer (or the partial one, on rec_flush)
+// is handed to the writer thread, which does the file I/O while the other one
+// fills. If the writer thread still holds the spare when the active buffer fills,
+// the record is dropped and counted rather than stalling the recording thread.
+
+#define _GNU_SOURCE
+#include "rec.h"
+#include "avt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REC_MAGIC    "AVTREC1\n"
+#define REC_BUF      65536
+#define REC_LINE_MAX 4096   // longer lines are truncated (the server caps lines at 2 KiB)
+
+struct rec_writer {
+    pthread_mutex_t mx; pthread_cond_t cv, done; pthread_t th; FILE *f;
+    uint64_t last_us; long count, dropped; int stop;
+    unsigned char *cur; size_t len;        // buffer being filled
+    unsigned char *out; size_t out_len;    // handed to the writer thread; NULL when it is idle
+    unsigned char buf[2][REC_BUF];
+};
+
+static uint64_t now_us(void){
+    struct timespec ts; clock_gettime(CLOCK_REALTIME,&ts);
+    return (uint64_t)ts.tv_sec*1000000u + (uint64_t)ts.tv_nsec/1000u;
+}
+
+static unsigned char *put_varint(unsigned char *p, uint64_t v){
+    while (v >= 0x80){ *p++ = (unsigned char)(v | 0x80); v >>= 7; }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// AUTH <user> <pass> is stored as AUTH <user> * (loadgen --auth-pass puts a
+// password back), also behind leading blanks or an @<key> prefix, since the line
+// is recorded before it is parsed. Returns how much of the line to keep; len when
+// nothing is hidden.
+static size_t redact(const char *line, size_t len){
+    size_t i=0, j;
+    while (i<len && (line[i]==' ' || line[i]=='\t')) i++;
+    if (i<len && line[i]=='@'){
+        while (i<len && line[i]!=' ') i++;
+        while (i<len && line[i]==' ') i++;
+    }
+    if (len-i<5 || memcmp(line+i,"AUTH ",5)!=0) return len;
+    i+=5;
+    while (i<len && line[i]==' ') i++;
+    while (i<len && line[i]!=' ') i++;
+    for (j=i; j<len && line[j]==' '; j++) ;
+    return j<len ? i : len;
+}
+
+// ---------- Writer ----------
+static void *writer_thread(void *arg){
+    rec_writer_t *w = arg;
+    pthread_mutex_lock(&w->mx);
+    for (;;){
+        while (!w->out && !w->stop) pthread_cond_wait(&w->cv, &w->mx);
+        if (!w->out) break;
+        unsigned char *b = w->out; size_t n = w->out_len;
+        pthread_mutex_unlock(&w->mx);
+        fwrite(b, 1, n, w->f); fflush(w->f);
+        pthread_mutex_lock(&w->mx);
+        w->out = NULL; pthread_cond_broadcast(&w->done);
+    }
+    pthread_mutex_unlock(&w->mx);
+    return NULL;
+}
+
+rec_writer_t *rec_create(const char *path){
+    rec_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+    if (!(w->f = fopen(path, "wb"))){ free(w); return NULL; }
+    pthread_mutex_init(&w->mx, NULL); pthread_cond_init(&w->cv, NULL); pthread_cond_init(&w->done, NULL);
+    w->cur = w->buf[0];
+    w->last_us = now_us();
+    unsigned char hdr[16]; memcpy(hdr, REC_MAGIC, 8);
+    for (int i=0; i<8; i++) hdr[8+i] = (unsigned char)(w->last_us >> (8*i));
+    fwrite(hdr, 1, sizeof(hdr), w->f); fflush(w->f);
+    int e = pthread_create(&w->th, NULL, writer_thread, w);
+    if (e){ fclose(w->f); free(w); errno = e; return NULL; }
+    return w;
+}
+
+// Hands the active buffer to the writer thread; -1 if that still holds the spare.
+static int handoff_locked(rec_writer_t *w){
+    if (!w->len) return 0;
+    if (w->out) return -1;
+    w->out = w->cur; w->out_len = w->len;
+    w->cur = w->cur==w->buf[0] ? w->buf[1] : w->buf[0]; w->len = 0;
+    pthread_cond_signal(&w->cv);
+    return 0;
+}
+
+void rec_put(void *arg, uint64_t sess, int event, const char *line, size_t len){
+    rec_writer_t *w = arg;
+    if (len > REC_LINE_MAX) len = REC_LINE_MAX;
+    size_t keep = line ? redact(line, len) : 0, stored = keep<len ? keep+2 : len;
+    uint64_t t = now_us();
+    pthread_mutex_lock(&w->mx);
+    if (w->len + 32 + stored > REC_BUF && handoff_locked(w)<0){
+        w->dropped++; pthread_mutex_unlock(&w->mx); return;
+    }
+    unsigned char *p = w->cur + w->len;
+    *p++ = (unsigned char)event;
+    p = put_varint(p, t > w->last_us ? t - w->last_us : 0);   // clock steps backwards: dt 0
+    p = put_varint(p, sess);
+    if (line){
+        p = put_varint(p, stored); memcpy(p, line, keep); p += keep;
+        if (stored!=keep){ memcpy(p, " *", 2); p += 2; }
+    }
+    if (t > w->last_us) w->last_us = t;
+    w->len = (size_t)(p - w->cur); w->count++;
+    pthread_mutex_unlock(&w->mx);
+}
+
+void rec_flush(rec_writer_t *w){
+    pthread_mutex_lock(&w->mx); handoff_locked(w); pthread_mutex_unlock(&w->mx);
+}
+
+void rec_sync(rec_writer_t *w){
+    pthread_mutex_lock(&w->mx);
+    while (w->out) pthread_cond_wait(&w->done, &w->mx);
+    handoff_locked(w);
+    while (w->out) pthread_cond_wait(&w->done, &w->mx);
+    pthread_mutex_unlock(&w->mx);
+}
+
+long rec_count(const rec_writer_t *w){ return w->count; }
+
+long rec_dropped(const rec_writer_t *w){ return w->dropped; }
+
+size_t rec_mem(const rec_writer_t *w){ (void)w; return sizeof(*w); }
+
+void rec_close(rec_writer_t *w){
+    if (!w) return;
+    rec_sync(w);
+    pthread_mutex_lock(&w->mx); w->stop = 1; pthread_cond_signal(&w->cv); pthread_mutex_unlock(&w->mx);
+    pthread_join(w->th, NULL);
+    fclose(w->f);
+    pthread_cond_destroy(&w->cv); pthread_cond_destroy(&w->done); pthread_mutex_destroy(&w->mx);
+    free(w);
+}
+
+// ---------- Reader ----------
+static int get_varint(rec_reader_t *r, uint64_t *v){
+    *v = 0;
+    for (int sh=0; sh<64 && r->p<r->end; sh+=7){
+        unsigned char b = *r->p++;
+        *v |= (uint64_t)(b & 0x7F) << sh;
+        if (!(b & 0x80)) return 0;
+    }
+    return -1;
+}
+
+int rec_open(rec_reader_t *r, const char *path){
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY);
+    if (fd<0) return -1;
+    struct stat sb;
+    if (fstat(fd,&sb)<0){ close(fd); return -1; }
+    if (sb.st_size < 16){ close(fd); errno = EINVAL; return -1; }
+    void *m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m==MAP_FAILED) return -1;
+    r->base = m; r->size = (size_t)sb.st_size; r->end = r->base + r->size;
+    if (memcmp(r->base, REC_MAGIC, 8)!=0){ rec_done(r); errno = EINVAL; return -1; }
+    for (int i=0; i<8; i++) r->start_us |= (uint64_t)r->base[8+i] << (8*i);
+    rec_rewind(r);
+    return 0;
+}
+
+void rec_rewind(rec_reader_t *r){ r->p = r->base + 16; r->t_us = 0; }
+
+int rec_next(rec_reader_t *r, rec_event_t *ev){
+    if (r->p >= r->end) return 0;
+    uint64_t dt, len = 0;
+    ev->event = *r->p++;
+    if (ev->event > AVT_REC_CLOSE || get_varint(r,&dt) || get_varint(r,&ev->sess)) return -1;
+    if (ev->event==AVT_REC_LINE && (get_varint(r,&len) || len > (uint64_t)(r->end - r->p))) return -1;
+    r->t_us += dt; ev->t_us = r->t_us;
+    ev->line = (const char *)r->p; ev->len = (size_t)len; r->p += len;
+    return 1;
+}
+
+void rec_done(rec_reader_t *r){
+    if (r->base) munmap((void*)r->base, r->size);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,47 @@
+// Autonomous Vehicle Project - session traffic capture (part of libavt)
+//
+// Compact record of every inbound command, written by the server with
+// --record and replayed by loadgen. File layout:
+//   "AVTREC1\n" <start: u64 LE, epoch microseconds>
+//   records:    <event: u8> <dt: varint us since previous record> <session: varint>
+//               [<len: varint> <bytes>]              (line events only)
+// Varints are LEB128. Events are AVT_REC_OPEN/LINE/CLOSE (avt.h). A typical
+// command costs 6-20 bytes; lines are taken verbatim, except that the password
+// of AUTH <user> <pass> is stored as "*".
+
+#ifndef REC_H
+#define REC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct rec_writer rec_writer_t;
+
+rec_writer_t *rec_create(const char *path);     // NULL (errno set) on failure
+// Appends one record; thread-safe, never touches the file. Signature matches avt_record_fn.
+void          rec_put(void *w, uint64_t sess, int event, const char *line, size_t len);
+// Hands what is buffered to the writer thread without waiting for it (a no-op
+// while that is busy); rec_sync waits until everything put so far is written.
+void          rec_flush(rec_writer_t *w);
+void          rec_sync(rec_writer_t *w);
+void          rec_close(rec_writer_t *w);       // syncs, stops the writer thread and frees
+long          rec_count(const rec_writer_t *w);
+long          rec_dropped(const rec_writer_t *w);   // records lost because both buffers were full
+size_t        rec_mem(const rec_writer_t *w);   // bytes the writer holds (its buffer included)
+
+typedef struct {
+    const unsigned char *base, *p, *end; size_t size;
+    uint64_t start_us, t_us;   // capture start; time of the last record read
+} rec_reader_t;
+
+typedef struct {
+    int event; uint64_t sess; uint64_t t_us;    // t_us: offset from the capture start
+    const char *line; size_t len;               // points into the mapping
+} rec_event_t;
+
+int  rec_open(rec_reader_t *r, const char *path);   // 0, or -1 (errno set; EINVAL: not a capture)
+int  rec_next(rec_reader_t *r, rec_event_t *ev);    // 1 event, 0 end, -1 truncated/corrupt
+void rec_rewind(rec_reader_t *r);
+void rec_done(rec_reader_t *r);
+
+#endif
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Write the PGO training capture (see `make pgo`).
+
+The workload `make pgo` trains the server on, as a loadgen capture (rec.h)
+generated from a fixed seed, so every build profiles the same traffic:
+  - observer fan-out: long-lived observers across TEXT/BIN/DELTA, some with
+    derived metrics, plus short sessions that connect, look and leave
+  - admin bursts: SPEED/TURN, BEGIN..COMMIT batches, idempotent @key
+    commands, LIST USERS, STATS and HISTORY (plain and points=)
+AUTH lines carry the redacted password "*", as --record writes them; loadgen
+sends its --auth-pass instead.
+Logging is exercised by the server itself: every session and command is
+written to its log file.
+
+Usage: pgo_train.py OUT [SECONDS]
+"""
+import random
+import struct
+import sys
+
+REC_OPEN, REC_LINE, REC_CLOSE = 0, 1, 2   # AVT_REC_* (avt.h)
+MAGIC = b"AVTREC1\n"
+START_US = 1700000000 * 1000000           # fixed, loadgen only uses offsets
+
+OBSERVERS = 24
+ADMINS = 3
+BURST_MS = 250
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        b = n & 0x7F
+        n >>= 7
+        if n:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def build(seconds, rng):
+    events = []   # (t_ms, session, event, line)
+    sess = 0
+
+    def session(t_open, t_close, lines):
+        nonlocal sess
+        sess += 1
+        events.append((t_open, sess, REC_OPEN, None))
+        for t, line in lines:
+            events.append((t, sess, REC_LINE, line))
+        if t_close is not None:
+            events.append((t_close, sess, REC_CLOSE, None))
+
+    end = seconds * 1000
+    for i in range(OBSERVERS):
+        t = rng.randrange(0, 500)
+        lines = [(t + 1, "HELLO name=obs%d" % i), (t + 2, "FORMAT " + ("TEXT", "BIN", "DELTA")[i % 3])]
+        if i % 4 == 0:
+            lines.append((t + 3, "DERIVED ALL"))
+        lines.append((t + 4, "ROLE?"))
+        session(t, end, lines)
+
+    t = 500
+    while t < end - 1000:   # churn: observers that come and go
+        life = rng.randrange(200, 1500)
+        session(t, t + life, [(t + 1, "HELLO name=visitor"), (t + 2, "FORMAT " + rng.choice(("TEXT", "BIN"))),
+                              (t + life // 2, "ROLE?")])
+        t += rng.randrange(50, 200)
+
+    for a in range(ADMINS):
+        t = 100 + a * 37
+        lines = [(t, "HELLO name=ops%d" % a), (t + 1, "AUTH admin *"), (t + 2, "SESSION")]
+        key = 0
+        t += BURST_MS
+        while t < end - 100:
+            burst = []
+            for _ in range(rng.randrange(2, 6)):
+                burst.append(rng.choice(("SPEED UP", "SLOW DOWN", "TURN LEFT", "TURN RIGHT")))
+            burst += ["BEGIN"] + [rng.choice(("SPEED UP", "SLOW DOWN", "TURN LEFT")) for _ in range(rng.randrange(1, 8))] + ["COMMIT"]
+            key += 1
+            burst += ["@k%d-%d SPEED UP" % (a, key), "@k%d-%d SPEED UP" % (a, key)]
+            r = rng.random()
+            if r < 0.3:
+                burst.append("LIST USERS 0 20")
+            elif r < 0.5:
+                burst.append("LIST USERS 0 10 obs")
+            elif r < 0.7:
+                burst.append("STATS")
+            elif r < 0.8:
+                burst.append("HISTORY -10")
+            else:
+                burst.append("HISTORY -60 0 points=40")
+            for k, line in enumerate(burst):
+                lines.append((t + k, line))
+            t += BURST_MS + rng.randrange(0, BURST_MS)
+        lines.append((end - 50, "QUIT"))
+        session(100 + a * 37 - 1, end, lines)
+
+    events.sort(key=lambda e: (e[0], e[1], e[2]))
+    return events
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__.strip().splitlines()[-1])
+    seconds = int(sys.argv[2]) if len(sys.argv) == 3 else 10
+    events = build(seconds, random.Random(98))
+    out = bytearray(MAGIC + struct.pack("<Q", START_US))
+    last = 0
+    for t, sess, ev, line in events:
+        out += bytes([ev]) + varint((t - last) * 1000) + varint(sess)
+        if line is not None:
+            data = line.encode()
+            out += varint(len(data)) + data
+        last = t
+    with open(sys.argv[1], "wb") as f:
+        f.write(out)
+
+
+if __name__ == "__main__":
+    main()
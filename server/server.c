@@ -1,269 +1,752 @@
 // Autonomous Vehicle Project - C Server (Berkeley Sockets + pthreads)
 // Transport: TCP (control + telemetry)
-// Run: ./server <port> <LogsFile>
+// Run: ./server <port> <LogsFile> [--max-conn N] [--max-per-ip N] [--admin-reserve N]
+//               [--ingest-udp PORT [--ingest-from ADDR]] [--replay-can FILE --can-map MAP [--replay-fast]]
+//               [--record FILE] [--tick-ms N] [--tick-cpu CPU] [--tick-prio P]
+//               [--client-cpus LIST] [--mlock] [--busy-poll CPU] [--notsent-lowat BYTES]
+//               [--rate-min HZ [--rate-max HZ]] [--mem-budget SIZE] [--rooms N] [--workers N]
+//               [--history SIZE [--history-spill FILE]]
 //
-// Application protocol (text, \n-terminated):
-//  Client -> Server:
-//    HELLO [name=<text>]
-//    AUTH <user> <pass>          (admin: admin / admin123)
-//    ROLE?
-//    LIST USERS                  (ADMIN only)
-//    SPEED UP | SLOW DOWN        (ADMIN only)
-//    TURN LEFT | TURN RIGHT      (ADMIN only)
-//    QUIT
-//  Server -> Client:
-//    OK <msg> | ERR <reason> | BYE
-//    TLM speed=<int>;battery=<int>;temp=<int>;dir=<N|E|S|W>;ts=<epoch>
+// Socket/thread front end over libavt (avt.h), which implements the vehicle
+// model and the AVT protocol; see avt.c for the command summary.
 //
-// Concurrency: 1 thread per client + 1 telemetry broadcaster thread (every 10s)
+// Concurrency: 1 thread per client + 1 telemetry broadcaster thread (every 10s,
+//              or --tick-ms; the vehicle model still steps every 10s)
+//              + 1 ingest thread with --ingest-udp (the vehicle model then stops:
+//              state comes from the binary TLM frames agents push to that port,
+//              bound to loopback unless --ingest-from names the one agent accepted)
+//              + 1 replay thread with --replay-can (candump log, see can.h; also
+//              stops the model)
+//              + 1 busy-poll reactor with --busy-poll: admin sessions move to it
+//              after AUTH and are served by spinning on non-blocking reads
+// Freshness: with --notsent-lowat each socket keeps at most BYTES unsent in the
+//              kernel; a tick finding the socket unwritable leaves its sample in
+//              the session (avt_session_set_ready), where the next tick replaces
+//              it, and the client thread writes it once POLLOUT fires
+// Rate:        with --rate-min each client's telemetry rate adapts between
+//              --rate-min and --rate-max (default: the tick rate), see avt.h
+// Rooms:       with --rooms N, HELLO room=<name> moves a client into one of up
+//              to N isolated contexts, created when an admin first names one;
+//              the tick thread steps and broadcasts all of them, ingest/replay
+//              feed the lobby, and AUTH backoff is the lobby's for every room
+// Workers:     with --workers N the server runs as processes: a supervisor, one
+//              simulation process (model, tick, ingest/replay; no clients) and N
+//              workers, each accepting on its own SO_REUSEPORT socket. Every tick
+//              the simulation publishes the sample to shared memory (shm.h) and
+//              the workers broadcast it; SPEED/TURN go back through a shared
+//              ring. A worker that crashes takes only its clients with it and is
+//              restarted. Admission, AUTH throttling, LIST USERS, idempotency
+//              records and STATS are per worker, so the limit options are refused
+// History:     with --history SIZE every broadcast sample is kept for HISTORY
+//              within SIZE bytes (raw first out, then rollups); --history-spill
+//              moves evicted raw blocks to FILE instead (per worker: FILE.<n>)
+// Memory:      client threads run on CLIENT_STACK-byte stacks; with
+//              --mem-budget, connections that would exceed it get ERR busy
 // Logging: console + file with timestamp and client ip:port
 
 #define _GNU_SOURCE
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
-#include <stdarg.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <strings.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "avt.h"
+#include "can.h"
+#include "rec.h"
+#include "shm.h"
+
 #define BACKLOG   32
 #define MAX_LINE  2048
+#define CLIENT_STACK (256*1024)   // per client thread; charged to the connection (AVT_MEM_CONN)
+#define RESERVED_AUTH_MS 10000    // a connection on an admin-reserve slot must AUTH within this
 
-typedef enum { ROLE_OBSERVER=0, ROLE_ADMIN=1 } role_t;
-typedef enum { DIR_N=0, DIR_E=1, DIR_S=2, DIR_W=3 } dir_t;
-
-typedef struct client_s {
-    int fd; struct sockaddr_in addr;
-    struct client_s *next;
-} client_t;
+typedef struct conn {
+    int fd; struct sockaddr_in addr; avt_admit_t adm;
+    int efd;   // --notsent-lowat: wakes the client thread when a sample is held; -1 otherwise
+    // Output; omx serializes writers. Once the reactor adopts the connection (nb), the
+    // socket is non-blocking and what it does not take waits in out for the reactor.
+    pthread_mutex_t omx; bool nb, err; char *out; size_t out_len, out_cap;
+    struct conn *bp_next; avt_sess_t *bp_s;   // busy-poll handoff (g_bp.in)
+} conn_t;
 
-typedef struct session_s {
-    int fd; struct sockaddr_in addr; role_t role;
-    char name[64];
-} session_t;
-
-// Globals
 static volatile sig_atomic_t g_sigstop = 0;
 static atomic_int g_stop = 0;
 static FILE *g_logf = NULL;
 static pthread_mutex_t g_log_mx = PTHREAD_MUTEX_INITIALIZER;
+static avt_ctx_t *g_avt = NULL;
+static int g_ingest_fd = -1;
+static uint32_t g_ingest_from = INADDR_ANY;   // --ingest-from: the only accepted agent; INADDR_ANY: loopback bind
+static const char *g_replay_path = NULL;
+static can_map_t g_can_map;
+static int g_replay_fast = 0;
+static rec_writer_t *g_rec = NULL;   // --record: inbound traffic capture for loadgen
+static int g_lowat = 0;              // --notsent-lowat: TCP_NOTSENT_LOWAT bytes, 0 = off
+
+// Rooms (--rooms N): appended under mx, never removed; n is published after the slot is ready
+typedef struct { char name[AVT_ROOM_NAME]; avt_ctx_t *ctx; } room_t;
+static struct { int max; atomic_int n; pthread_mutex_t mx; room_t *r; } g_rooms = { .mx=PTHREAD_MUTEX_INITIALIZER };
 
-static client_t *g_clients = NULL;
-static pthread_mutex_t g_clients_mx = PTHREAD_MUTEX_INITIALIZER;
+// Multi-process mode (--workers N); proc tags this process's log lines
+#define WORKER_RESTART_MS 1000   // minimum gap between restarts of one worker
+static struct { int n; shm_region_t *m; char proc[16]; } g_mp;
 
-// Vehicle state
-static pthread_mutex_t g_state_mx = PTHREAD_MUTEX_INITIALIZER;
-static int   g_speed   = 0;   // 0..100
-static int   g_battery = 100; // 0..100
-static int   g_temp    = 35;  // °C
-static dir_t g_dir     = DIR_N;
+// Tick scheduling (--tick-*, --client-cpus, --mlock); every option degrades to a warning
+#define MODEL_STEP_MS  10000   // vehicle model period, independent of the tick
+#define PREFAULT_STACK (256*1024)
+static struct {
+    int tick_ms, tick_cpu, tick_prio, mlock;
+    int has_client_cpus; cpu_set_t client_cpus;
+} g_rt = { .tick_ms=MODEL_STEP_MS, .tick_cpu=-1 };
+
+// Busy-poll reactor for admin sessions (--busy-poll CPU). Client threads push
+// adopted connections onto the lock-free list `in`; only the reactor touches e[].
+#define BP_MAX          64    // sessions the reactor serves; more stay on their threads
+#define BP_BUSY_POLL_US 50    // SO_BUSY_POLL budget per socket read
+#define BP_OUT_MAX      CLIENT_STACK   // queued output per session before it is dropped
+static struct {
+    int on, cpu, efd;                 // efd: wakes the reactor while it sleeps empty
+    _Atomic(conn_t *) in; atomic_int count;
+    int n; conn_t *e[BP_MAX];
+} g_bp = { .efd=-1 };
 
 // ---------- Utils / Logging ----------
 static void on_sigint(int sig){ (void)sig; g_sigstop = 1; atomic_store(&g_stop,1); }
 
-static void peer_id(const struct sockaddr_in* a, char *out, size_t sz){
-    char ip[64]; inet_ntop(AF_INET,&a->sin_addr,ip,sizeof(ip));
-    snprintf(out,sz,"%s:%u", ip, ntohs(a->sin_port));
-}
-
-static void log_line(const char *peer, const char *fmt, ...){
-    va_list ap; va_start(ap, fmt);
+// user: the room_t a room's context logs for, NULL for the lobby
+static void log_line(void *user, const char *peer, const char *msg){
+    const room_t *room=user;
     pthread_mutex_lock(&g_log_mx);
     time_t now=time(NULL); struct tm tm; localtime_r(&now,&tm);
     char ts[32]; strftime(ts,sizeof(ts),"%Y-%m-%d %H:%M:%S",&tm);
-    fprintf(stderr,"[%s] %s ", ts, peer?peer:"-");
-    vfprintf(stderr, fmt, ap); fprintf(stderr,"\n");
-    if (g_logf){
-        fprintf(g_logf,"[%s] %s ", ts, peer?peer:"-");
-        va_list ap2; va_start(ap2,fmt);
-        vfprintf(g_logf, fmt, ap2); va_end(ap2);
-        fprintf(g_logf,"\n"); fflush(g_logf);
-    }
+    char tag[AVT_ROOM_NAME+2]=""; if (room) snprintf(tag,sizeof(tag),"@%s ",room->name);
+    fprintf(stderr,"[%s] %s%s%s %s\n", ts, g_mp.proc, tag, peer?peer:"-", msg);
+    if (g_logf){ fprintf(g_logf,"[%s] %s%s%s %s\n", ts, g_mp.proc, tag, peer?peer:"-", msg); fflush(g_logf); }
     pthread_mutex_unlock(&g_log_mx);
-    va_end(ap);
 }
 
-static const char* dir_str(dir_t d){ return (d==DIR_N?"N":d==DIR_E?"E":d==DIR_S?"S":"W"); }
+static void conn_free(conn_t *c){
+    close(c->fd); if (c->efd>=0) close(c->efd);
+    if (c->out_cap) avt_mem_charge(g_avt, AVT_MEM_CONN, -(long)c->out_cap);
+    pthread_mutex_destroy(&c->omx); free(c->out); free(c);
+}
+
+// Sends what the socket takes now; on a non-blocking socket the rest is queued. <0 on failure.
+static int send_all(void *user, const char *buf, size_t len){
+    conn_t *c=user; int rc=0;
+    pthread_mutex_lock(&c->omx);
+    while(len && !c->err && !c->out_len){
+        ssize_t n=send(c->fd,buf,len,MSG_NOSIGNAL);
+        if(n<0){ if(errno==EINTR) continue; if(c->nb && errno==EAGAIN) break; c->err=true; break; }
+        buf+=n; len-=(size_t)n;
+    }
+    if (len && !c->err){
+        if (c->out_len+len > BP_OUT_MAX) c->err=true;   // the peer stopped reading
+        else {
+            if (c->out_len+len > c->out_cap){   // the queue is charged to AVT_MEM_CONN as it grows
+                size_t cap=c->out_cap ? c->out_cap : 4096; while (cap < c->out_len+len) cap*=2;
+                char *o=NULL;
+                if (!avt_mem_reserve(g_avt, AVT_MEM_CONN, (long)(cap-c->out_cap))) c->err=true;
+                else if (!(o=realloc(c->out,cap))){ avt_mem_charge(g_avt, AVT_MEM_CONN, -(long)(cap-c->out_cap)); c->err=true; }
+                else { c->out=o; c->out_cap=cap; }
+            }
+            if (!c->err){ memcpy(c->out+c->out_len,buf,len); c->out_len+=len; }
+        }
+    }
+    if (c->err) rc=-1;
+    pthread_mutex_unlock(&c->omx);
+    return rc;
+}
 
-// ---------- Client registry ----------
-static void add_client(client_t *c){
-    pthread_mutex_lock(&g_clients_mx);
-    c->next = g_clients; g_clients = c;
-    pthread_mutex_unlock(&g_clients_mx);
+// Reactor side: pushes queued output; <0 once the connection has failed.
+static int out_flush(conn_t *c){
+    pthread_mutex_lock(&c->omx);
+    size_t off=0;
+    while(off<c->out_len && !c->err){
+        ssize_t n=send(c->fd,c->out+off,c->out_len-off,MSG_NOSIGNAL|MSG_DONTWAIT);
+        if(n<0){ if(errno==EINTR) continue; if(errno!=EAGAIN) c->err=true; break; }
+        off+=(size_t)n;
+    }
+    memmove(c->out,c->out+off,c->out_len-off); c->out_len-=off;
+    if (!c->out_len && c->out_cap){   // drained: give the queue and its charge back
+        avt_mem_charge(g_avt, AVT_MEM_CONN, -(long)c->out_cap);
+        free(c->out); c->out=NULL; c->out_cap=0;
+    }
+    int rc=c->err ? -1 : 0;
+    pthread_mutex_unlock(&c->omx);
+    return rc;
 }
-static void remove_client(int fd){
-    pthread_mutex_lock(&g_clients_mx);
-    client_t **pp=&g_clients, *c=g_clients;
-    while(c){ if(c->fd==fd){ *pp=c->next; close(c->fd); free(c); break; } pp=&c->next; c=c->next; }
-    pthread_mutex_unlock(&g_clients_mx);
+
+// ---------- Threads ----------
+static void warn(const char *what, int err){
+    char msg[160]; snprintf(msg,sizeof(msg),"warning: %s: %s (continuing without it)", what, strerror(err));
+    log_line(NULL, NULL, msg);
 }
-static void list_users_to(int fd){
-    pthread_mutex_lock(&g_clients_mx);
-    int count=0; for(client_t *c=g_clients;c;c=c->next) count++;
-    dprintf(fd, "OK %d users\n", count);
-    for(client_t *c=g_clients;c;c=c->next){
-        char ip[64]; inet_ntop(AF_INET,&c->addr.sin_addr,ip,sizeof(ip));
-        dprintf(fd, "USER %s:%u ROLE=? NAME=?\n", ip, ntohs(c->addr.sin_port));
+
+// "64M", "512k", "1G" or plain bytes; -1 on a malformed size
+static long parse_size(const char *p){
+    char *end; long v=strtol(p,&end,10);
+    if (end==p || v<0) return -1;
+    switch(*end){
+    case 'k': case 'K': v<<=10; end++; break;
+    case 'm': case 'M': v<<=20; end++; break;
+    case 'g': case 'G': v<<=30; end++; break;
     }
-    pthread_mutex_unlock(&g_clients_mx);
+    return *end ? -1 : v;
 }
 
-// ---------- Vehicle control ----------
-static int apply_speed_change(int delta, char *why, size_t wsz){
-    int ok=1;
-    pthread_mutex_lock(&g_state_mx);
-    if (g_battery < 15) { snprintf(why,wsz,"battery low"); ok=0; }
-    else {
-        int ns = g_speed + delta;
-        if (ns < 0) { ns = 0; snprintf(why,wsz,"min speed"); ok=0; }
-        else if (ns > 100) { ns = 100; snprintf(why,wsz,"max speed"); ok=0; }
-        else { g_speed = ns; snprintf(why,wsz,"speed=%d", g_speed); ok=1; }
+// "0-3,6" -> set; returns -1 on a malformed list
+static int parse_cpus(const char *p, cpu_set_t *set){
+    CPU_ZERO(set);
+    while (*p){
+        char *e; long a=strtol(p,&e,10), b=a;
+        if (e==p || a<0 || a>=CPU_SETSIZE) return -1;
+        if (*e=='-'){ p=e+1; b=strtol(p,&e,10); if (e==p || b<a || b>=CPU_SETSIZE) return -1; }
+        for (long i=a;i<=b;i++) CPU_SET((int)i,set);
+        p = *e==',' ? e+1 : e;
+        if (*e && *e!=',') return -1;
     }
-    pthread_mutex_unlock(&g_state_mx);
-    return ok;
+    return 0;
 }
-static void apply_turn_left(int left){
-    pthread_mutex_lock(&g_state_mx);
-    int di = (int)g_dir + (left?-1:+1);
-    if(di<0) di=3; if(di>3) di=0; g_dir=(dir_t)di;
-    pthread_mutex_unlock(&g_state_mx);
+
+static void tick_setup(void){
+    int rc;
+    if (g_rt.tick_cpu>=0){
+        cpu_set_t set; CPU_ZERO(&set); CPU_SET(g_rt.tick_cpu,&set);
+        if ((rc=pthread_setaffinity_np(pthread_self(),sizeof(set),&set))) warn("tick CPU affinity", rc);
+    }
+    if (g_rt.tick_prio>0){
+        struct sched_param sp={ .sched_priority=g_rt.tick_prio };
+        if ((rc=pthread_setschedparam(pthread_self(),SCHED_FIFO,&sp))) warn("SCHED_FIFO for the tick", rc);
+    }
+    if (g_rt.mlock){   // fault in the stack the tick will use while memory is locked
+        volatile char stack[PREFAULT_STACK]; long page=sysconf(_SC_PAGESIZE);
+        for (size_t i=0; i<sizeof(stack); i+=(size_t)page) stack[i]=0;   // through the volatile lvalue, one write per page
+    }
 }
 
-// ---------- Telemetry ----------
-static void broadcast_tlm(void){
-    char line[256];
-    time_t now=time(NULL);
-    struct tm tm;
-    localtime_r(&now, &tm);
-    char ts[32];
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
-    pthread_mutex_lock(&g_state_mx);
-    int sp=g_speed, bt=g_battery, tp=g_temp;
-    const char* ds=dir_str(g_dir);
-    pthread_mutex_unlock(&g_state_mx);
-    snprintf(line, sizeof(line), "TLM speed=%d;battery=%d;temp=%d;dir=%s;ts=%s\n", 
-             sp, bt, tp, ds, ts);    
-    pthread_mutex_lock(&g_clients_mx);
-    for(client_t *c=g_clients; c; c=c->next) send(c->fd, line, strlen(line), 0);
-    pthread_mutex_unlock(&g_clients_mx);
+static void ts_add_ms(struct timespec *t, long ms){
+    t->tv_sec += ms/1000; t->tv_nsec += (ms%1000)*1000000L;
+    if (t->tv_nsec>=1000000000L){ t->tv_sec++; t->tv_nsec-=1000000000L; }
 }
+static long ts_diff_us(const struct timespec *a, const struct timespec *b){
+    return (long)(a->tv_sec-b->tv_sec)*1000000L + (a->tv_nsec-b->tv_nsec)/1000;
+}
+
+// ---------- Rooms ----------
+// avt_room_fn: finds the room by name or, for an ADMIN, creates it while slots
+// (and the memory budget) last.
+static avt_ctx_t *room_find(void *user, const char *name, int create){
+    (void)user; avt_ctx_t *ctx=NULL;
+    pthread_mutex_lock(&g_rooms.mx);
+    int n=atomic_load(&g_rooms.n);
+    for (int i=0;i<n && !ctx;i++) if (strcmp(g_rooms.r[i].name,name)==0) ctx=g_rooms.r[i].ctx;
+    if (!ctx && create && n<g_rooms.max && (ctx=avt_room_create(g_avt))){
+        room_t *r=&g_rooms.r[n];
+        snprintf(r->name,sizeof(r->name),"%s",name); r->ctx=ctx;
+        avt_set_logger(ctx, log_line, r);
+        if (g_rec) avt_set_recorder(ctx, rec_put, g_rec);
+        atomic_store(&g_rooms.n, n+1);
+        log_line(r, NULL, "room created");
+    }
+    pthread_mutex_unlock(&g_rooms.mx);
+    return ctx;
+}
+
+// Ticks on absolute CLOCK_MONOTONIC deadlines, so lateness does not accumulate;
+// after an overrun the schedule restarts from now instead of bursting. The model
+// steps at the first tick on or after each MODEL_STEP_MS deadline, so it keeps a
+// 10 s period on average whatever --tick-ms is (steps jitter by up to one tick).
 static void *telemetry_thread(void *arg){
     (void)arg;
+    tick_setup();
+    struct timespec next, now, step_at; clock_gettime(CLOCK_MONOTONIC,&next);
+    step_at=next;
     while(!atomic_load(&g_stop)){
-        pthread_mutex_lock(&g_state_mx);
-        if (g_speed>0 && g_battery>0) g_battery -= (g_speed>=60?2:1);
-        if (g_battery < 0) g_battery = 0;
-        if (g_speed>70 && g_temp<80) g_temp++; else if (g_temp>35) g_temp--;
-        pthread_mutex_unlock(&g_state_mx);
-        broadcast_tlm();
-        for(int i=0;i<10 && !atomic_load(&g_stop);i++) sleep(1);
+        bool boundary = ts_diff_us(&next,&step_at)>=0;
+        if (boundary){
+            ts_add_ms(&step_at, MODEL_STEP_MS);
+            if (ts_diff_us(&next,&step_at)>=0){ step_at=next; ts_add_ms(&step_at, MODEL_STEP_MS); }   // stalled: no catch-up burst
+        }
+        int nrooms=atomic_load(&g_rooms.n); time_t t=time(NULL);
+        if (boundary && g_ingest_fd<0 && !g_replay_path) avt_step(g_avt);
+        if (g_mp.m){ tlm_sample_t cur; avt_sample(g_avt,&cur,t); shm_publish(g_mp.m,&cur); }
+        else avt_broadcast(g_avt, t);
+        for (int i=0;i<nrooms;i++){ if (boundary) avt_step(g_rooms.r[i].ctx); avt_broadcast(g_rooms.r[i].ctx, t); }
+        if (boundary && g_rec) rec_flush(g_rec);
+        ts_add_ms(&next, g_rt.tick_ms);
+        for(;;){   // wake at least once a second to notice g_stop
+            clock_gettime(CLOCK_MONOTONIC,&now);
+            if (atomic_load(&g_stop) || ts_diff_us(&next,&now)<=0) break;
+            struct timespec until=now; ts_add_ms(&until,1000);
+            if (ts_diff_us(&until,&next)>0) until=next;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+        }
+        long late=ts_diff_us(&now,&next); bool overrun = late >= g_rt.tick_ms*1000L;
+        avt_tick_note(g_avt, late>0?late:0, overrun);
+        for (int i=0;i<nrooms;i++) avt_tick_note(g_rooms.r[i].ctx, late>0?late:0, overrun);
+        if (overrun) next=now;
     }
     return NULL;
 }
 
-// ---------- Client thread ----------
-static void *client_thread(void *arg){
-    client_t *cli=(client_t*)arg;
-    session_t s = { .fd=cli->fd, .addr=cli->addr, .role=ROLE_OBSERVER, .name = "" };
-    char pid[80]; peer_id(&s.addr,pid,sizeof(pid));
-    log_line(pid, "connected");
+// --workers: broadcasts each sample the simulation process publishes. Lateness
+// is the publish-to-wake delay; a tick missed entirely counts as an overrun.
+static void *follower_thread(void *arg){
+    (void)arg;
+    uint32_t last=shm_tick(g_mp.m);
+    while(!atomic_load(&g_stop)){
+        uint32_t t=shm_wait_tick(g_mp.m, last, 1000);
+        if (t==last) continue;
+        tlm_sample_t cur; long age_us;
+        shm_read(g_mp.m, &cur, &age_us);
+        avt_ingest(g_avt, &cur, 1);
+        avt_broadcast(g_avt, cur.ts);
+        avt_tick_note(g_avt, age_us, t-last>1);
+        last=t;
+    }
+    return NULL;
+}
 
-    dprintf(s.fd,"OK Welcome. Commands: HELLO|AUTH|ROLE?|LIST USERS|SPEED ...|TURN ...|QUIT\n");
+static void *ingest_thread(void *arg){
+    (void)arg;
+    avt_ingest_buf_t *b=avt_ingest_buf_new(g_avt);
+    if (!b){ perror("ingest"); return NULL; }
+    while(!atomic_load(&g_stop))
+        if (avt_ingest_udp(g_avt, g_ingest_fd, g_ingest_from, b)<0){ perror("ingest"); break; }
+    avt_ingest_buf_free(g_avt, b);
+    return NULL;
+}
 
-    char buf[MAX_LINE], *p, *nl;
-    for(;;){
-        ssize_t n = recv(s.fd, buf, sizeof(buf)-1, 0);
-        if(n<=0) break; buf[n]='\0'; p=buf;
-        while((nl=strchr(p,'\n'))){
-            *nl='\0'; size_t L=strlen(p); if(L&&p[L-1]=='\r') p[L-1]='\0';
-            log_line(pid, "REQ: %s", p);
-
-            if(strcmp(p,"QUIT")==0){
-                dprintf(s.fd,"BYE\n"); log_line(pid,"BYE"); goto out;
-            } else if(strncmp(p,"HELLO",5)==0){
-                const char *k=strstr(p,"name="); if(k){ k+=5; while(*k==' ') k++; strncpy(s.name,k,sizeof(s.name)-1); }
-                dprintf(s.fd,"OK hello %s\n", s.name[0]?s.name:"observer");
-            } else if(strncmp(p,"AUTH ",5)==0){
-                char u[64]={0}, pw[64]={0};
-                if(sscanf(p+5,"%63s %63s",u,pw)==2 && strcmp(u,"admin")==0 && strcmp(pw,"admin123")==0){
-                    s.role=ROLE_ADMIN; dprintf(s.fd,"OK admin\n");
-                } else dprintf(s.fd,"ERR invalid credentials\n");
-            } else if(strcmp(p,"ROLE?")==0){
-                dprintf(s.fd,"OK %s\n", s.role==ROLE_ADMIN?"ADMIN":"OBSERVER");
-            } else if(strcmp(p,"LIST USERS")==0){
-                if(s.role!=ROLE_ADMIN) dprintf(s.fd,"ERR forbidden\n");
-                else list_users_to(s.fd);
-            } else if(strcmp(p,"SPEED UP")==0 || strcmp(p,"SLOW DOWN")==0){
-                if(s.role!=ROLE_ADMIN) dprintf(s.fd,"ERR forbidden\n");
-                else { char why[64]; int ok=apply_speed_change(strstr(p,"UP")?+5:-5, why, sizeof(why));
-                       dprintf(s.fd,"%s %s\n", ok?"OK":"ERR", why); }
-            } else if(strcmp(p,"TURN LEFT")==0 || strcmp(p,"TURN RIGHT")==0){
-                if(s.role!=ROLE_ADMIN) dprintf(s.fd,"ERR forbidden\n");
-                else { apply_turn_left(strstr(p,"LEFT")!=NULL);
-                       pthread_mutex_lock(&g_state_mx);
-                       const char *ds=dir_str(g_dir);
-                       pthread_mutex_unlock(&g_state_mx);
-                       dprintf(s.fd,"OK dir=%s\n", ds); }
-            } else {
-                dprintf(s.fd,"ERR unknown\n");
+static void *replay_thread(void *arg){
+    (void)arg;
+    can_stats_t st; char msg[160];
+    if (can_replay(g_avt, g_replay_path, &g_can_map, !g_replay_fast, &g_stop, &st)<0)
+        snprintf(msg,sizeof(msg),"replay %s: %s", g_replay_path, strerror(errno));
+    else
+        snprintf(msg,sizeof(msg),"replay done: lines=%ld frames=%ld matched=%ld bad=%ld bytes=%zu",
+                 st.lines, st.frames, st.matched, st.bad, st.bytes);
+    log_line(NULL, NULL, msg);
+    return NULL;
+}
+
+static int ingest_open(int port){
+    int fd=socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd<0){ perror("socket"); return -1; }
+    int rcvbuf=4<<20; setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv={ .tv_sec=1 }; setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)); // lets the thread see g_stop
+    struct sockaddr_in a; bzero(&a,sizeof(a));
+    // Agents drive the vehicle every client sees: local ones only, unless --ingest-from names one
+    a.sin_family=AF_INET; a.sin_port=htons((uint16_t)port);
+    a.sin_addr.s_addr = g_ingest_from!=INADDR_ANY ? htonl(INADDR_ANY) : htonl(INADDR_LOOPBACK);
+    if (bind(fd,(struct sockaddr*)&a,sizeof(a))<0){ perror("bind ingest"); close(fd); return -1; }
+    return fd;
+}
+
+// ---------- Busy-poll reactor ----------
+// Takes over an admin session from its client thread; 0 if the reactor is full.
+static int bp_adopt(conn_t *c, avt_sess_t *s){
+    if (atomic_fetch_add(&g_bp.count,1)>=BP_MAX){ atomic_fetch_sub(&g_bp.count,1); return 0; }
+    int one=1, us=BP_BUSY_POLL_US;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(c->fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us));   // best effort: needs kernel support
+    pthread_mutex_lock(&c->omx);   // no send in flight while the socket changes mode
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK); c->nb=true;
+    pthread_mutex_unlock(&c->omx);
+    c->bp_s=s; c->bp_next=atomic_load(&g_bp.in);
+    while (!atomic_compare_exchange_weak(&g_bp.in, &c->bp_next, c)) ;
+    uint64_t v=1; if (write(g_bp.efd,&v,sizeof(v))<0){ /* counter full: already awake */ }
+    return 1;
+}
+
+// Spins over its sockets with non-blocking reads and sends on a dedicated core;
+// sleeps only while empty. A peer that stops reading only grows its own queue.
+static void *busy_poll_thread(void *arg){
+    (void)arg;
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(g_bp.cpu,&set);
+    int rc=pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+    if (rc) warn("busy-poll CPU affinity", rc);
+    char buf[MAX_LINE];
+    while(!atomic_load(&g_stop)){
+        for (conn_t *c=atomic_exchange(&g_bp.in,NULL), *nx; c; c=nx){ nx=c->bp_next; g_bp.e[g_bp.n++]=c; }
+        if (!g_bp.n){
+            struct pollfd p={ .fd=g_bp.efd, .events=POLLIN };
+            if (poll(&p,1,1000)==1){ uint64_t v; if (read(g_bp.efd,&v,sizeof(v))<0){ /* raced */ } }
+            continue;
+        }
+        for(int i=0;i<g_bp.n;i++){
+            conn_t *c=g_bp.e[i]; avt_sess_t *s=c->bp_s;
+            if (c->efd>=0 && avt_session_pending(s)){
+                struct pollfd p={ .fd=c->fd, .events=POLLOUT };
+                if (poll(&p,1,0)==1) avt_session_flush(s);
+            }
+            if (out_flush(c)==0){
+                ssize_t n=recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n<0 && (errno==EAGAIN || errno==EINTR)) continue;
+                if (n>0 && !avt_session_feed(s, buf, (size_t)n) && out_flush(c)==0) continue;
             }
-            log_line(pid, "DONE");
-            p = nl+1;
+            avt_mem_charge(g_avt, AVT_MEM_CONN, CLIENT_STACK);   // avt_session_close returns conn_mem
+            avt_session_close(s); conn_free(c);
+            g_bp.e[i--]=g_bp.e[--g_bp.n]; atomic_fetch_sub(&g_bp.count,1);
         }
     }
-out:
-    remove_client(s.fd);
     return NULL;
 }
 
-// ---------- main ----------
-int main(int argc, char **argv){
-    if (argc!=3){ fprintf(stderr,"Usage: %s <port> <LogsFile>\n", argv[0]); return 1; }
-    int port = atoi(argv[1]); if(port<=0 || port>65535){ fprintf(stderr,"Invalid port\n"); return 1; }
-    g_logf = fopen(argv[2],"a"); /* optional */
+// ---------- Client threads ----------
+// avt_ready_fn for --notsent-lowat: POLLOUT only fires while less than the low
+// watermark is unsent. When the peer is behind, wakes its thread to wait for it.
+static int sock_ready(void *user){
+    conn_t *c=user; struct pollfd p={ .fd=c->fd, .events=POLLOUT };
+    if (poll(&p,1,0)==1) return 1;
+    uint64_t one=1; if (write(c->efd,&one,sizeof(one))<0){ /* counter full: already awake */ }
+    return 0;
+}
 
-    signal(SIGINT, on_sigint);
+// Waits until the peer sent something, flushing a held sample whenever the
+// socket drains below the low watermark meanwhile; <0 on error.
+static long mono_ms(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (long)ts.tv_sec*1000L+ts.tv_nsec/1000000L;
+}
 
-    int sfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sfd<0){ perror("socket"); return 1; }
-    int yes=1; setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+// Waits until the socket is readable: 1, 0 once deadline (mono_ms, 0 = none) passes, -1 on error.
+// With --notsent-lowat it also flushes the held sample whenever the socket drains.
+static int wait_readable(conn_t *c, avt_sess_t *s, long deadline){
+    for(;;){
+        int tmo=-1;
+        if (deadline && (tmo=(int)(deadline-mono_ms()))<=0) return 0;
+        struct pollfd p[2]={ { .fd=c->fd, .events=POLLIN|(c->efd>=0 && avt_session_pending(s)?POLLOUT:0) },
+                             { .fd=c->efd, .events=POLLIN } };
+        if (poll(p, c->efd>=0 ? 2 : 1, tmo)<0){ if(errno==EINTR) continue; return -1; }
+        if (c->efd>=0 && (p[1].revents & POLLIN)){ uint64_t v; if (read(c->efd,&v,sizeof(v))<0){ /* raced with another read */ } }
+        if (p[0].revents & POLLOUT) avt_session_flush(s);
+        if (p[0].revents & (POLLIN|POLLHUP|POLLERR)) return 1;
+    }
+}
 
+static void *client_thread(void *arg){
+    conn_t *c=(conn_t*)arg;
+    if (g_rt.has_client_cpus) pthread_setaffinity_np(pthread_self(),sizeof(g_rt.client_cpus),&g_rt.client_cpus);
+    avt_sess_t *s=avt_session_open(g_avt, &c->addr, c->fd, c->adm, send_all, c);
+    if (s && g_lowat){
+        if (setsockopt(c->fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &g_lowat, sizeof(g_lowat))==0
+            && (c->efd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))>=0) avt_session_set_ready(s, sock_ready);
+    }
+    // An admin-reserve slot is for admins: one that has not authenticated by the
+    // deadline (idle, or sending anything but a good AUTH) is closed and the slot released.
+    long deadline = c->adm==AVT_ADMIT_RESERVED ? mono_ms()+RESERVED_AUTH_MS : 0;
+    char buf[MAX_LINE];
+    while(s){
+        if (deadline && avt_session_admin(s)) deadline=0;
+        if (c->efd>=0 || deadline){
+            int r=wait_readable(c,s,deadline);
+            if (r==0){
+                static const char msg[]="ERR auth timeout\n";
+                char peer[64], ip[INET_ADDRSTRLEN]; inet_ntop(AF_INET,&c->addr.sin_addr,ip,sizeof(ip));
+                snprintf(peer,sizeof(peer),"%s:%d",ip,ntohs(c->addr.sin_port));
+                send_all(c,msg,sizeof(msg)-1); log_line(NULL,peer,"reserved slot released: no AUTH in time");
+            }
+            if (r<=0) break;
+        }
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if(n<=0 || avt_session_feed(s, buf, (size_t)n)) break;
+        if (g_bp.on && avt_session_admin(s) && bp_adopt(c,s)){
+            avt_mem_charge(g_avt, AVT_MEM_CONN, -CLIENT_STACK);   // this stack is freed; the reactor charges its queue
+            return NULL;
+        }
+    }
+    if (s) avt_session_close(s);
+    conn_free(c);
+    return NULL;
+}
+
+static int listen_open(int port, int reuseport){
+    int fd=socket(AF_INET, SOCK_STREAM, 0);
+    if (fd<0){ perror("socket"); return -1; }
+    int yes=1; setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes))<0){ perror("SO_REUSEPORT"); close(fd); return -1; }
     struct sockaddr_in srv; bzero(&srv,sizeof(srv));
     srv.sin_family=AF_INET; srv.sin_addr.s_addr=htonl(INADDR_ANY); srv.sin_port=htons((uint16_t)port);
-    if (bind(sfd,(struct sockaddr*)&srv,sizeof(srv))<0){ perror("bind"); return 1; }
-    if (listen(sfd,BACKLOG)<0){ perror("listen"); return 1; }
-
-    pthread_t th_tlm; pthread_create(&th_tlm,NULL,telemetry_thread,NULL);
+    if (bind(fd,(struct sockaddr*)&srv,sizeof(srv))<0){ perror("bind"); close(fd); return -1; }
+    if (listen(fd,BACKLOG)<0){ perror("listen"); close(fd); return -1; }
+    return fd;
+}
 
-    fprintf(stderr,"Server listening on %d (Ctrl+C to stop)\n", port);
-    for(;;){
-        if (g_sigstop) break;
+// Accepts clients until SIGINT, one detached thread each.
+static void serve(int sfd){
+    pthread_attr_t client_attr; pthread_attr_init(&client_attr);
+    pthread_attr_setstacksize(&client_attr, CLIENT_STACK);
+    while(!g_sigstop){
+        struct pollfd p={ .fd=sfd, .events=POLLIN };   // SIGINT may land on any thread: look at g_sigstop every second
+        if (poll(&p,1,1000)<=0) continue;
         struct sockaddr_in cli; socklen_t cl=sizeof(cli);
         int cfd = accept(sfd,(struct sockaddr*)&cli,&cl);
-        if (cfd<0){ if(errno==EINTR) continue; perror("accept"); break; }
-        client_t *c = calloc(1,sizeof(*c)); c->fd=cfd; c->addr=cli; add_client(c);
-        pthread_t th; pthread_create(&th,NULL,client_thread,c); pthread_detach(th);
+        if (cfd<0){ if(errno==EINTR || errno==ECONNABORTED) continue; perror("accept"); break; }
+        avt_admit_t adm=avt_admit(g_avt, cli.sin_addr.s_addr);
+        if (adm==AVT_ADMIT_REFUSED){
+            static const char busy[]="ERR busy\n";
+            send(cfd,busy,sizeof(busy)-1,MSG_DONTWAIT|MSG_NOSIGNAL); close(cfd); continue;
+        }
+        conn_t *c = calloc(1,sizeof(*c)); pthread_t th;
+        if (c){ c->fd=cfd; c->addr=cli; c->adm=adm; c->efd=-1; pthread_mutex_init(&c->omx,NULL); }
+        if (!c || pthread_create(&th,&client_attr,client_thread,c)!=0){
+            avt_release(g_avt, cli.sin_addr.s_addr, adm); free(c); close(cfd); continue;
+        }
+        pthread_detach(th);
+    }
+    pthread_attr_destroy(&client_attr);
+}
+
+// ---------- Processes (--workers) ----------
+enum { PROC_SINGLE=0, PROC_SIM, PROC_WORKER };
+
+static void describe_exit(int st, char *buf, size_t n){
+    if (WIFSIGNALED(st)) snprintf(buf,n,"killed by signal %d", WTERMSIG(st));
+    else snprintf(buf,n,"exited with status %d", WEXITSTATUS(st));
+}
+
+// Forks the simulation process and the workers, then stays behind as the
+// supervisor: restarts workers that die and stops everything on SIGINT or when
+// the simulation process is gone. Returns only in a child, with its role (and,
+// for a worker, its listening socket in *sfd).
+static int supervise(int port, int *sfd){
+    int n=g_mp.n; int *lfd=calloc((size_t)n,sizeof(int)); pid_t *pid=calloc((size_t)n,sizeof(pid_t));
+    long *started=calloc((size_t)n,sizeof(long));
+    if (!lfd || !pid || !started){ fprintf(stderr,"Out of memory\n"); exit(1); }
+    if (!(g_mp.m=shm_create())){ perror("shared memory"); exit(1); }
+    for (int i=0;i<n;i++) if ((lfd[i]=listen_open(port,1))<0) exit(1);   // kept open here: queued connections survive a restart
+    pid_t sim=fork();
+    if (sim<0){ perror("fork"); exit(1); }
+    if (sim==0){
+        for (int i=0;i<n;i++) close(lfd[i]);
+        snprintf(g_mp.proc,sizeof(g_mp.proc),"sim ");
+        return PROC_SIM;
+    }
+    fprintf(stderr,"Server listening on %d with %d workers (Ctrl+C to stop)\n", port, n);
+    int stopping=0; char msg[160], how[64];
+    for(;;){
+        for (int i=0;i<n && !stopping;i++){
+            if (pid[i]) continue;
+            long wait=started[i]+WORKER_RESTART_MS-mono_ms();   // a worker that keeps crashing restarts at most once a second
+            if (started[i] && wait>0){ struct timespec t={ wait/1000, (wait%1000)*1000000L }; nanosleep(&t,NULL); }
+            started[i]=mono_ms();
+            pid_t p=fork();
+            if (p==0){
+                for (int k=0;k<n;k++) if (k!=i) close(lfd[k]);
+                *sfd=lfd[i]; snprintf(g_mp.proc,sizeof(g_mp.proc),"w%d ", i+1);
+                return PROC_WORKER;
+            }
+            if (p<0){ perror("fork"); break; }
+            pid[i]=p;
+        }
+        int st; pid_t p=waitpid(-1,&st,0);
+        if (p<0){
+            if (errno==ECHILD) break;
+            if (g_sigstop && !stopping){
+                stopping=1; kill(sim,SIGINT);
+                for (int k=0;k<n;k++) if (pid[k]) kill(pid[k],SIGINT);
+            }
+            continue;
+        }
+        describe_exit(st,how,sizeof(how));
+        if (p==sim){
+            if (stopping) continue;
+            snprintf(msg,sizeof(msg),"simulation process %s; stopping", how); log_line(NULL,NULL,msg);
+            stopping=1; for (int k=0;k<n;k++) if (pid[k]) kill(pid[k],SIGINT);
+            continue;
+        }
+        for (int i=0;i<n;i++) if (pid[i]==p){
+            pid[i]=0; shm_reap(g_mp.m,p);
+            if (!stopping){ snprintf(msg,sizeof(msg),"worker %d (pid %d) %s; restarting", i+1, (int)p, how); log_line(NULL,NULL,msg); }
+        }
+    }
+    if (g_logf) fclose(g_logf);
+    exit(0);
+}
+
+// ---------- main ----------
+static void usage(const char *prog){
+    fprintf(stderr,"Usage: %s <port> <LogsFile> [--max-conn N] [--max-per-ip N] [--admin-reserve N]"
+                   " [--ingest-udp PORT [--ingest-from ADDR]] [--replay-can FILE --can-map MAP [--replay-fast]]"
+                   " [--record FILE] [--tick-ms N] [--tick-cpu CPU] [--tick-prio P] [--client-cpus LIST] [--mlock]"
+                   " [--busy-poll CPU] [--notsent-lowat BYTES]"
+                   " [--rate-min HZ [--rate-max HZ]] [--mem-budget SIZE] [--rooms N] [--workers N]"
+                   " [--history SIZE [--history-spill FILE]]\n", prog);
+}
+
+int main(int argc, char **argv){
+    static const struct option longopts[] = {
+        {"max-conn",      required_argument, NULL, 'c'},
+        {"max-per-ip",    required_argument, NULL, 'i'},
+        {"admin-reserve", required_argument, NULL, 'a'},
+        {"ingest-udp",    required_argument, NULL, 'u'},
+        {"ingest-from",   required_argument, NULL, 'F'},
+        {"replay-can",    required_argument, NULL, 'r'},
+        {"can-map",       required_argument, NULL, 'm'},
+        {"replay-fast",   no_argument,       NULL, 'f'},
+        {"record",        required_argument, NULL, 'w'},
+        {"tick-ms",       required_argument, NULL, 'T'},
+        {"tick-cpu",      required_argument, NULL, 'C'},
+        {"tick-prio",     required_argument, NULL, 'P'},
+        {"client-cpus",   required_argument, NULL, 'L'},
+        {"mlock",         no_argument,       NULL, 'M'},
+        {"busy-poll",     required_argument, NULL, 'B'},
+        {"notsent-lowat", required_argument, NULL, 'N'},
+        {"rate-min",      required_argument, NULL, 'R'},
+        {"rate-max",      required_argument, NULL, 'X'},
+        {"mem-budget",    required_argument, NULL, 'G'},
+        {"rooms",         required_argument, NULL, 'O'},
+        {"workers",       required_argument, NULL, 'W'},
+        {"history",       required_argument, NULL, 'H'},
+        {"history-spill", required_argument, NULL, 'S'},
+        {NULL,0,NULL,0}
+    };
+    double rate_min=0, rate_max=0;
+    int opt, ingest_port=0, limits=0; const char *map_path=NULL, *rec_path=NULL;
+    avt_config_t cfg; avt_config_default(&cfg);
+    while((opt=getopt_long(argc,argv,"",longopts,NULL))!=-1){
+        switch(opt){
+        case 'c': cfg.max_conn=atoi(optarg); limits=1; break;
+        case 'i': cfg.max_per_ip=atoi(optarg); limits=1; break;
+        case 'a': cfg.admin_reserve=atoi(optarg); limits=1; break;
+        case 'u': ingest_port=atoi(optarg); break;
+        case 'F': if (inet_pton(AF_INET,optarg,&g_ingest_from)!=1 || g_ingest_from==INADDR_ANY){ fprintf(stderr,"Invalid ingest address\n"); return 1; }
+                  break;
+        case 'r': g_replay_path=optarg; break;
+        case 'm': map_path=optarg; break;
+        case 'f': g_replay_fast=1; break;
+        case 'w': rec_path=optarg; break;
+        case 'T': g_rt.tick_ms=atoi(optarg); break;
+        case 'C': g_rt.tick_cpu=atoi(optarg); break;
+        case 'P': g_rt.tick_prio=atoi(optarg); break;
+        case 'L': if (parse_cpus(optarg,&g_rt.client_cpus)<0){ fprintf(stderr,"Invalid CPU list\n"); return 1; }
+                  g_rt.has_client_cpus=1; break;
+        case 'M': g_rt.mlock=1; break;
+        case 'B': g_bp.on=1; g_bp.cpu=atoi(optarg); break;
+        case 'N': g_lowat=atoi(optarg); break;
+        case 'R': rate_min=atof(optarg); break;
+        case 'X': rate_max=atof(optarg); break;
+        case 'O': g_rooms.max=atoi(optarg); break;
+        case 'W': g_mp.n=atoi(optarg); break;
+        case 'H': if ((cfg.hist_mem=parse_size(optarg))<=0){ fprintf(stderr,"Invalid history size\n"); return 1; }
+                  break;
+        case 'S': cfg.hist_spill=optarg; break;
+        case 'G': if ((cfg.mem_budget=parse_size(optarg))<=0){ fprintf(stderr,"Invalid memory budget\n"); return 1; }
+                  break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc-optind!=2){ usage(argv[0]); return 1; }
+    if (cfg.max_conn<0 || cfg.max_per_ip<1 || cfg.admin_reserve<0){ fprintf(stderr,"Invalid limits\n"); return 1; }
+    int port = atoi(argv[optind]); if(port<=0 || port>65535){ fprintf(stderr,"Invalid port\n"); return 1; }
+    if (ingest_port<0 || ingest_port>65535){ fprintf(stderr,"Invalid ingest port\n"); return 1; }
+    if (g_ingest_from!=INADDR_ANY && !ingest_port){ fprintf(stderr,"--ingest-from needs --ingest-udp\n"); return 1; }
+    if (g_bp.on && (g_bp.cpu<0 || g_bp.cpu>=CPU_SETSIZE)){ fprintf(stderr,"Invalid busy-poll CPU\n"); return 1; }
+    if (rate_min<0 || rate_max<0 || (rate_max && !rate_min) || (rate_max && rate_max<rate_min)){ fprintf(stderr,"Invalid rates\n"); return 1; }
+    if (g_rooms.max<0){ fprintf(stderr,"Invalid room count\n"); return 1; }
+    if (cfg.hist_spill && !cfg.hist_mem){ fprintf(stderr,"--history-spill needs --history\n"); return 1; }
+    if (g_mp.n<0){ fprintf(stderr,"Invalid worker count\n"); return 1; }
+    if (g_mp.n && (g_rooms.max || rec_path)){ fprintf(stderr,"--workers does not combine with --rooms or --record\n"); return 1; }
+    if (g_mp.n && limits){   // each worker admits on its own: the totals would be N times the option
+        fprintf(stderr,"--max-conn, --max-per-ip and --admin-reserve are per process and not supported with --workers\n"); return 1;
+    }
+    if (g_lowat<0){ fprintf(stderr,"Invalid low watermark\n"); return 1; }
+    if (g_rt.tick_ms<1 || g_rt.tick_prio<0 || g_rt.tick_prio>99){ fprintf(stderr,"Invalid tick options\n"); return 1; }
+    cfg.tick_ms=g_rt.tick_ms;
+    cfg.conn_mem=CLIENT_STACK+(long)sizeof(conn_t);
+    if (rate_min){   // rates to periods in whole ticks
+        cfg.period_max=(int)(1000.0/(rate_min*g_rt.tick_ms)+0.5);
+        cfg.period_min=rate_max ? (int)(1000.0/(rate_max*g_rt.tick_ms)+0.5) : 1;
+        if (cfg.period_max<1) cfg.period_max=1;
+    }
+    if (!g_replay_path != !map_path){ fprintf(stderr,"--replay-can and --can-map go together\n"); return 1; }
+    if (map_path){
+        char err[256];
+        if (can_map_load(map_path,&g_can_map,err,sizeof(err))<0){ fprintf(stderr,"%s\n", err); return 1; }
+    }
+    g_logf = fopen(argv[optind+1],"a"); /* optional */
+
+    struct sigaction sa={ .sa_handler=on_sigint };   // no SA_RESTART: the supervisor's waitpid must see it
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    int sfd=-1, proc = g_mp.n ? supervise(port,&sfd) : PROC_SINGLE;
+    char spill[512];
+    if (proc==PROC_WORKER && cfg.hist_spill){   // one spill file per worker
+        snprintf(spill,sizeof(spill),"%s.%s", cfg.hist_spill, g_mp.proc+1); spill[strcspn(spill," ")]='\0';
+        cfg.hist_spill=spill;
+    }
+    if (proc==PROC_SIM) cfg.hist_mem=0;   // no clients to query it
+    if (!(g_avt=avt_create(&cfg))){ fprintf(stderr,"Cannot create the context: %s\n", strerror(errno)); return 1; }
+    avt_set_logger(g_avt, log_line, NULL);
+    if (proc==PROC_WORKER) avt_set_control(g_avt, shm_control, g_mp.m);
+    if (g_rt.mlock && mlockall(MCL_CURRENT|MCL_FUTURE)<0) warn("mlockall", errno);
+    if (g_rooms.max){
+        if (!(g_rooms.r=calloc((size_t)g_rooms.max,sizeof(room_t)))){ fprintf(stderr,"Out of memory\n"); return 1; }
+        avt_set_rooms(g_avt, room_find, NULL);
+    }
+    if (rec_path){
+        if (!(g_rec=rec_create(rec_path))){ perror(rec_path); return 1; }
+        avt_set_recorder(g_avt, rec_put, g_rec);
+        avt_mem_charge(g_avt, AVT_MEM_CAPTURE, (long)rec_mem(g_rec));
+    }
+    if (proc==PROC_SINGLE && (sfd=listen_open(port,0))<0) return 1;
+
+    pthread_t th_tlm, th_ing, th_rep, th_bp;
+    int clients = proc!=PROC_SIM, sim = proc!=PROC_WORKER;
+    if (sim && ingest_port && (g_ingest_fd=ingest_open(ingest_port))<0) return 1;
+    pthread_create(&th_tlm,NULL,sim?telemetry_thread:follower_thread,NULL);
+    if (clients && g_bp.on){
+        if ((g_bp.efd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))<0){ perror("eventfd"); return 1; }
+        pthread_create(&th_bp,NULL,busy_poll_thread,NULL);
+    }
+    if (g_ingest_fd>=0){
+        pthread_create(&th_ing,NULL,ingest_thread,NULL);
+        fprintf(stderr,"Ingesting UDP telemetry on %d (simulation off)\n", ingest_port);
+    }
+    if (sim && g_replay_path){
+        pthread_create(&th_rep,NULL,replay_thread,NULL);
+        fprintf(stderr,"Replaying %s%s (simulation off)\n", g_replay_path, g_replay_fast?" as fast as possible":"");
+    }
+
+    if (proc==PROC_SIM) while(!g_sigstop) shm_serve(g_mp.m, g_avt, 1000);   // control from the workers
+    else {
+        if (proc==PROC_SINGLE) fprintf(stderr,"Server listening on %d (Ctrl+C to stop)\n", port);
+        serve(sfd);
     }
     atomic_store(&g_stop,1);
     pthread_join(th_tlm,NULL);
+    if (g_ingest_fd>=0){ pthread_join(th_ing,NULL); close(g_ingest_fd); }
+    if (sim && g_replay_path) pthread_join(th_rep,NULL);
+    if (clients && g_bp.on) pthread_join(th_bp,NULL);
 
-    pthread_mutex_lock(&g_clients_mx);
-    for(client_t *c=g_clients;c;){
-        client_t *n=c->next; close(c->fd); free(c); c=n;
+    // client threads may still be inside the context; it is reclaimed at exit
+    if (sfd>=0) close(sfd);
+    if (g_rec){   // not closed: client threads may still record
+        rec_sync(g_rec);
+        if (rec_dropped(g_rec)){
+            char msg[96]; snprintf(msg,sizeof(msg),"record: %ld records dropped (disk too slow)", rec_dropped(g_rec));
+            log_line(NULL, NULL, msg);
+        }
     }
-    g_clients=NULL;
-    pthread_mutex_unlock(&g_clients_mx);
-
-    close(sfd);
     if (g_logf) fclose(g_logf);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+// Autonomous Vehicle Project - shared state for multi-process servers (see shm.h)
+//
+// Readers never block the writer: a sample is a few dozen bytes, copied between
+// two loads of the sequence counter and retried if a publish raced with it.
+// Waits use process-shared futexes on words inside the mapping, so an idle
+// worker or simulation process sleeps instead of polling.
+
+#define _GNU_SOURCE
+#include "shm.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHM_RING     64     // outstanding control requests across all workers
+#define SHM_STEPS    64     // > BATCH_MAX (avt.c) steps plus the terminator
+#define SHM_REPLY    128
+#define SHM_WAIT_MS  100    // producer futex wait slice
+#define SHM_CALL_MS  3000   // then a request not yet started is withdrawn ("ERR unavailable")
+
+enum { SLOT_FREE=0, SLOT_REQ, SLOT_RUN, SLOT_DONE, SLOT_DEAD };
+
+// A request runs only if the consumer claims it (REQ -> RUN) before the producer
+// withdraws it (REQ -> DEAD), so "ERR unavailable" always means nothing was applied.
+typedef struct {
+    _Atomic uint32_t state;   // futex word: FREE -> REQ (producer) -> RUN -> DONE (consumer) -> FREE (producer),
+                              // or REQ -> DEAD (producer gave up) -> FREE (consumer, skipping it)
+    atomic_int orphan;        // the producer died: whoever sees DONE frees the slot
+    pid_t owner; int batch;
+    char steps[SHM_STEPS], reply[SHM_REPLY];
+} shm_slot_t;
+
+struct shm_region {
+    // state: seq is odd while a publish is in progress
+    _Atomic uint32_t seq, tick;
+    uint64_t pub_ns; tlm_sample_t s;
+    // control ring
+    pthread_mutex_t prod_mx; uint32_t tail;   // tail, enq under prod_mx
+    int enq;                                  // an enqueue is in progress (see enqueue_recover)
+    _Atomic uint32_t posted;                  // futex word: bumped per request
+    uint32_t head;                            // consumer only
+    shm_slot_t slot[SHM_RING];
+};
+
+static long futex(_Atomic uint32_t *w, int op, uint32_t v, const struct timespec *t){
+    return syscall(SYS_futex, (uint32_t*)w, op, v, t, NULL, 0);
+}
+static void futex_wait_ms(_Atomic uint32_t *w, uint32_t v, int ms){
+    struct timespec t={ ms/1000, (long)(ms%1000)*1000000L };
+    futex(w, FUTEX_WAIT, v, &t);
+}
+
+static uint64_t mono_ns(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+shm_region_t *shm_create(void){
+    shm_region_t *m=mmap(NULL, sizeof(*m), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (m==MAP_FAILED) return NULL;
+    pthread_mutexattr_t a; pthread_mutexattr_init(&a);
+    pthread_mutexattr_setpshared(&a, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&a, PTHREAD_MUTEX_ROBUST);
+    int rc=pthread_mutex_init(&m->prod_mx, &a);
+    pthread_mutexattr_destroy(&a);
+    if (rc){ munmap(m, sizeof(*m)); errno=rc; return NULL; }
+    return m;
+}
+
+// ---------- State ----------
+void shm_publish(shm_region_t *m, const tlm_sample_t *s){
+    uint32_t q=atomic_load_explicit(&m->seq, memory_order_relaxed);
+    atomic_store_explicit(&m->seq, q+1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    m->s=*s; m->pub_ns=mono_ns();
+    atomic_store_explicit(&m->seq, q+2, memory_order_release);
+    atomic_fetch_add(&m->tick, 1);
+    futex(&m->tick, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+uint32_t shm_tick(shm_region_t *m){ return atomic_load(&m->tick); }
+
+uint32_t shm_wait_tick(shm_region_t *m, uint32_t last, int timeout_ms){
+    if (atomic_load(&m->tick)==last) futex_wait_ms(&m->tick, last, timeout_ms);
+    return atomic_load(&m->tick);
+}
+
+void shm_read(shm_region_t *m, tlm_sample_t *s, long *age_us){
+    uint64_t t;
+    for(;;){
+        uint32_t q=atomic_load_explicit(&m->seq, memory_order_acquire);
+        if (q & 1){ sched_yield(); continue; }
+        *s=m->s; t=m->pub_ns;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&m->seq, memory_order_relaxed)==q) break;
+    }
+    *age_us=(long)((mono_ns()-t)/1000);
+}
+
+// ---------- Control ring ----------
+// Frees a DONE slot nobody is waiting for; safe to race with the other side doing the same.
+static void slot_drop(shm_slot_t *sl){
+    uint32_t done=SLOT_DONE;
+    atomic_compare_exchange_strong(&sl->state, &done, SLOT_FREE);
+}
+
+// prod_mx came back EOWNERDEAD: a producer died inside the critical section.
+// If it had published its slot but not advanced tail, finish the enqueue.
+static void enqueue_recover(shm_region_t *m){
+    if (m->enq && atomic_load(&m->slot[m->tail % SHM_RING].state)==SLOT_REQ) m->tail++;
+    m->enq=0;
+    pthread_mutex_consistent(&m->prod_mx);
+}
+
+void shm_control(void *user, const char *steps, int batch, char *reply, size_t rsz){
+    shm_region_t *m=user;
+    if (strlen(steps)>=SHM_STEPS){ snprintf(reply,rsz,"ERR batch too long"); return; }
+    if (pthread_mutex_lock(&m->prod_mx)==EOWNERDEAD) enqueue_recover(m);
+    shm_slot_t *sl=&m->slot[m->tail % SHM_RING];
+    if (atomic_load(&sl->state)!=SLOT_FREE){
+        pthread_mutex_unlock(&m->prod_mx);
+        snprintf(reply,rsz,"ERR busy"); return;
+    }
+    m->enq=1;
+    sl->owner=getpid(); sl->batch=batch; strcpy(sl->steps, steps);
+    atomic_store(&sl->orphan, 0);
+    atomic_store_explicit(&sl->state, SLOT_REQ, memory_order_release);
+    m->tail++; m->enq=0;
+    pthread_mutex_unlock(&m->prod_mx);
+    atomic_fetch_add(&m->posted, 1);
+    futex(&m->posted, FUTEX_WAKE, 1, NULL);
+
+    uint32_t st;
+    for (int waited=0; (st=atomic_load_explicit(&sl->state, memory_order_acquire))==SLOT_REQ || st==SLOT_RUN; waited+=SHM_WAIT_MS){
+        uint32_t req=SLOT_REQ;
+        if (waited>=SHM_CALL_MS && st==SLOT_REQ && atomic_compare_exchange_strong(&sl->state, &req, SLOT_DEAD)){
+            snprintf(reply,rsz,"ERR unavailable"); return;
+        }
+        futex_wait_ms(&sl->state, st, SHM_WAIT_MS);   // once running, the reply is moments away
+    }
+    snprintf(reply,rsz,"%s", sl->reply);
+    atomic_store(&sl->state, SLOT_FREE);
+}
+
+int shm_serve(shm_region_t *m, avt_ctx_t *ctx, int timeout_ms){
+    uint32_t posted=atomic_load(&m->posted); int n=0;
+    for(;;){
+        shm_slot_t *sl=&m->slot[m->head % SHM_RING];
+        uint32_t req=SLOT_REQ;
+        if (!atomic_compare_exchange_strong(&sl->state, &req, SLOT_RUN)){
+            if (req!=SLOT_DEAD) break;
+            atomic_store(&sl->state, SLOT_FREE); m->head++; continue;   // withdrawn by its producer
+        }
+        if (avt_control(ctx, sl->steps, sl->batch, sl->reply, sizeof(sl->reply))<0)
+            snprintf(sl->reply,sizeof(sl->reply),"ERR bad steps");
+        atomic_store_explicit(&sl->state, SLOT_DONE, memory_order_release);
+        if (atomic_load(&sl->orphan)) slot_drop(sl);
+        else futex(&sl->state, FUTEX_WAKE, 1, NULL);
+        m->head++; n++;
+    }
+    if (!n) futex_wait_ms(&m->posted, posted, timeout_ms);
+    return n;
+}
+
+// A producer that died after queuing leaves a REQ or DONE slot with its pid
+// (one that died holding prod_mx is repaired by enqueue_recover).
+void shm_reap(shm_region_t *m, pid_t pid){
+    for (int i=0;i<SHM_RING;i++){
+        shm_slot_t *sl=&m->slot[i];
+        if (atomic_load(&sl->state)==SLOT_FREE || sl->owner!=pid) continue;
+        atomic_store(&sl->orphan, 1); slot_drop(sl);
+    }
+}
@@ -0,0 +1,46 @@
+// Autonomous Vehicle Project - shared state for multi-process servers (part of libavt)
+//
+// Backs server.c --workers: one simulation process owns the vehicle, worker
+// processes own the client sockets. The region is an anonymous MAP_SHARED
+// mapping created before fork() and holds:
+//   - the latest vehicle sample, published once per tick under a seqlock; the
+//     tick counter doubles as a futex that wakes the workers to broadcast it;
+//   - a ring of control requests (SPEED/TURN steps, see avt_set_control) that
+//     workers fill and the simulation process drains in order, answering in
+//     the request's slot.
+// Producers enqueue under a robust process-shared mutex, so a worker that dies
+// mid-enqueue does not wedge the others; shm_reap() frees its outstanding slots.
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "avt.h"
+
+typedef struct shm_region shm_region_t;
+
+shm_region_t *shm_create(void);    // NULL (errno set) on failure; never unmapped
+
+// ---- State (one writer) ----
+void     shm_publish(shm_region_t *m, const tlm_sample_t *s);
+uint32_t shm_tick(shm_region_t *m);                                   // samples published so far
+// Waits up to timeout_ms for a tick newer than last; returns the current tick.
+uint32_t shm_wait_tick(shm_region_t *m, uint32_t last, int timeout_ms);
+// Latest sample and how long ago (us) it was published.
+void     shm_read(shm_region_t *m, tlm_sample_t *s, long *age_us);
+
+// ---- Control ring (many producers, one consumer) ----
+// avt_control_fn (user: the region): queues the steps and waits for the
+// simulation's reply; "ERR busy" when the ring is full, "ERR unavailable"
+// when the simulation has not started the request within a few seconds (the
+// request is then withdrawn and never applied).
+void     shm_control(void *m, const char *steps, int batch, char *reply, size_t rsz);
+// Answers queued requests in order with avt_control(ctx); when none are
+// queued, waits up to timeout_ms for one. Returns the number answered.
+int      shm_serve(shm_region_t *m, avt_ctx_t *ctx, int timeout_ms);
+// Releases the slots a dead producer process left behind.
+void     shm_reap(shm_region_t *m, pid_t pid);
+
+#endif
@@ -0,0 +1,132 @@
+// Autonomous Vehicle Project - TLM frame encoders (see tlm.h)
+
+#include "tlm.h"
+
+#include <string.h>
+
+static const char k_digits2[200] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+// Writes v in decimal at p (same output as "%d"); returns the end pointer.
+static char *put_int(char *p, int32_t v){
+    uint32_t u = (uint32_t)v;
+    if (v < 0){ *p++ = '-'; u = 0u - u; }
+    char tmp[10]; char *t = tmp + sizeof(tmp);
+    while (u >= 100){ unsigned r = u % 100; u /= 100; t -= 2; memcpy(t, &k_digits2[r*2], 2); }
+    if (u >= 10){ t -= 2; memcpy(t, &k_digits2[u*2], 2); }
+    else *--t = (char)('0' + u);
+    size_t n = (size_t)(tmp + sizeof(tmp) - t);
+    memcpy(p, t, n);
+    return p + n;
+}
+static void put2(char *p, int v){ memcpy(p, &k_digits2[v*2], 2); }
+
+static void clock_refresh(tlm_clock_t *clk, time_t now){
+    struct tm tm; localtime_r(&now, &tm);
+    char *p = clk->ts; int y = tm.tm_year + 1900;
+    if (y < 1000 || y > 9999){ clk->len = strftime(clk->ts, sizeof(clk->ts), "%Y-%m-%d %H:%M:%S", &tm); }
+    else {
+        put2(p, y/100); put2(p+2, y%100); p[4]='-';
+        put2(p+5, tm.tm_mon+1); p[7]='-'; put2(p+8, tm.tm_mday); p[10]=' ';
+        put2(p+11, tm.tm_hour); p[13]=':'; put2(p+14, tm.tm_min); p[16]=':'; put2(p+17, tm.tm_sec);
+        p[19]='\0'; clk->len = 19;
+    }
+    clk->sec = now; clk->valid = 1;
+}
+
+static char *put_le(char *p, uint64_t v, int n){
+    for (int i=0; i<n; i++) p[i] = (char)(v >> (8*i));
+    return p + n;
+}
+
+_Static_assert(TLM_NFIELDS <= 8, "delta mask is one byte");
+
+#define PUT_LIT(p, s) (memcpy((p), (s), sizeof(s)-1), (p) + sizeof(s)-1)
+
+// Per-kind field writers
+#define TEXT_INT(p, v)   ((p) = put_int((p), (v)))
+#define TEXT_DIR(p, v)   (*(p)++ = (v))
+#define TEXT_TIME(p, v)  ((void)(v), memcpy((p), clk->ts, clk->len), (p) += clk->len)
+#define BIN_INT(p, v)    ((p) = put_le((p), (uint32_t)(v), 4))
+#define BIN_DIR(p, v)    (*(p)++ = (v))
+#define BIN_TIME(p, v)   ((p) = put_le((p), (uint64_t)(v), 8))
+
+size_t tlm_encode_text(tlm_clock_t *clk, char *out, const tlm_sample_t *s){
+    if (!clk->valid || clk->sec != (time_t)s->ts) clock_refresh(clk, (time_t)s->ts);
+    char *p = PUT_LIT(out, "TLM");
+    // every field is written as ";name=value"; the first ';' becomes the space after "TLM"
+#define TLM_FIELD(name, kind) p = PUT_LIT(p, ";" #name "="); TEXT_##kind(p, s->name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    out[3] = ' ';
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+size_t tlm_encode_bin(char *out, const tlm_sample_t *s){
+    char *p = out + 3;
+#define TLM_FIELD(name, kind) BIN_##kind(p, s->name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    out[0] = (char)TLM_BIN_MAGIC; out[1] = 'F'; out[2] = (char)(p - out - 3);
+    return (size_t)(p - out);
+}
+
+size_t tlm_encode_delta(char *out, const tlm_sample_t *prev, const tlm_sample_t *cur){
+    char *p = out + 4; unsigned mask = 0;
+#define TLM_FIELD(name, kind) \
+    if (cur->name != prev->name){ mask |= 1u << TLM_F_##name; BIN_##kind(p, cur->name); }
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    out[0] = (char)TLM_BIN_MAGIC; out[1] = 'D'; out[2] = (char)(p - out - 3); out[3] = (char)mask;
+    return (size_t)(p - out);
+}
+
+// ---------- Decoding ----------
+static uint64_t get_le(const unsigned char *p, int n){
+    uint64_t v = 0;
+    for (int i=0; i<n; i++) v |= (uint64_t)p[i] << (8*i);
+    return v;
+}
+
+#define SIZE_INT   4
+#define SIZE_DIR   1
+#define SIZE_TIME  8
+#define GET_INT(p, v)    ((v) = (int32_t)(uint32_t)get_le((p), 4), (p) += 4)
+#define GET_DIR(p, v)    ((v) = (char)*(p)++)
+#define GET_TIME(p, v)   ((v) = (int64_t)get_le((p), 8), (p) += 8)
+
+enum {
+    BIN_FULL_LEN = 0
+#define TLM_FIELD(name, kind) + SIZE_##kind
+#include "tlm_schema.def"
+#undef TLM_FIELD
+};
+
+int tlm_decode_bin(const char *in, size_t len, tlm_sample_t *s){
+    const unsigned char *b = (const unsigned char *)in;
+    if (len < 3) return 0;
+    if (b[0] != TLM_BIN_MAGIC || (b[1] != 'F' && b[1] != 'D')) return -1;
+    size_t n = b[2];
+    if (len < 3 + n) return 0;
+    const unsigned char *p = b + 3;
+    if (b[1] == 'F'){
+        if (n != (size_t)BIN_FULL_LEN) return -1;
+#define TLM_FIELD(name, kind) GET_##kind(p, s->name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    } else {
+        if (n < 1) return -1;
+        unsigned mask = *p++; size_t need = 1;
+#define TLM_FIELD(name, kind) if (mask & (1u << TLM_F_##name)) need += SIZE_##kind;
+#include "tlm_schema.def"
+#undef TLM_FIELD
+        if (need != n || (mask >> TLM_NFIELDS)) return -1;
+#define TLM_FIELD(name, kind) if (mask & (1u << TLM_F_##name)) GET_##kind(p, s->name);
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    }
+    return (int)(3 + n);
+}
@@ -0,0 +1,59 @@
+// Autonomous Vehicle Project - TLM frame encoders (and binary decoder)
+//
+// The field set comes from tlm_schema.def; each encoder below is expanded from
+// it at compile time, so there is no per-field lookup at run time.
+//
+// Text (default):  TLM speed=<int>;battery=<int>;temp=<int>;dir=<c>;ts=<YYYY-MM-DD HH:MM:SS>\n
+//   Byte-identical to the former snprintf/strftime formatting, but constant
+//   labels are copied, integers are written two digits at a time and the
+//   timestamp text is cached in a tlm_clock_t until the second changes.
+// Binary full:     0xA7 'F' <len:u8> <fields in schema order>
+// Binary delta:    0xA7 'D' <len:u8> <mask:u8> <fields whose bit is set in mask>
+//   Bit i of mask is field i of the schema; a delta is relative to the frame
+//   sent on the previous tick.
+
+#ifndef TLM_H
+#define TLM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TLM_LINE_MAX   128    // upper bound of an encoded text line (incl. '\n')
+#define TLM_BIN_MAGIC  0xA7   // first byte of a binary frame; never starts a text line
+#define TLM_BIN_MAX    64     // upper bound of an encoded binary frame
+
+#define TLM_CTYPE_INT  int32_t
+#define TLM_CTYPE_DIR  char
+#define TLM_CTYPE_TIME int64_t
+
+typedef struct {
+#define TLM_FIELD(name, kind) TLM_CTYPE_##kind name;
+#include "tlm_schema.def"
+#undef TLM_FIELD
+} tlm_sample_t;
+
+enum {
+#define TLM_FIELD(name, kind) TLM_F_##name,
+#include "tlm_schema.def"
+#undef TLM_FIELD
+    TLM_NFIELDS
+};
+
+typedef enum { TLM_FMT_TEXT=0, TLM_FMT_BIN=1, TLM_FMT_DELTA=2 } tlm_fmt_t;
+
+// Per-encoder timestamp cache; not shared between threads. Zero-initialise.
+typedef struct { time_t sec; int valid; size_t len; char ts[32]; } tlm_clock_t;
+
+// Each encoder writes into out (>= TLM_LINE_MAX / TLM_BIN_MAX bytes, not
+// NUL-terminated) and returns the encoded length.
+size_t tlm_encode_text(tlm_clock_t *clk, char *out, const tlm_sample_t *s);
+size_t tlm_encode_bin(char *out, const tlm_sample_t *s);
+size_t tlm_encode_delta(char *out, const tlm_sample_t *prev, const tlm_sample_t *cur);
+
+// Decodes one binary frame at in: a full frame overwrites *s, a delta updates
+// only the fields in its mask. Returns the frame length, 0 if in holds only
+// part of a frame, or -1 if it is not a well-formed frame.
+int    tlm_decode_bin(const char *in, size_t len, tlm_sample_t *s);
+
+#endif